@@ -0,0 +1,146 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "arena.h"
+
+struct _ArenaBlock {
+    struct _ArenaBlock *next;
+    char *end;
+};
+
+/*
+ * Block memory can be allocated with any alignment, first byte is aligned
+ * here:
+ */
+#define ARENA_FIRST(b) \
+    ((char *)(((size_t)((b) + 1) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1)))
+
+Arena arena_create( size_t block_size )
+{
+    Arena arena = Calloc( sizeof( struct _Arena ), 1 );
+
+    if( !arena ) {
+        return NULL;
+    }
+
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    __initlock( arena->lock );
+    return arena;
+}
+
+void arena_destroy( Arena arena )
+{
+    struct _ArenaBlock *b = arena->head;
+
+    while( b ) {
+        struct _ArenaBlock *next = b->next;
+        Free( b );
+        b = next;
+    }
+
+    Free( arena );
+}
+
+void arena_reset( Arena arena )
+{
+    __lock( arena->lock );
+    arena->current = NULL;
+    arena->next = arena->end = NULL;
+    __unlock( arena->lock );
+}
+
+/*
+ * Internal, make current the next block with at least 'size' bytes: kept by
+ * arena_reset() or new one. Call with lock held.
+ */
+static int _arena_next_block( Arena arena, size_t size )
+{
+    struct _ArenaBlock *b = arena->current ? arena->current->next : arena->head;
+
+    while( b && ( size_t )( b->end - ARENA_FIRST( b ) ) < size ) {
+        b = b->next;
+    }
+
+    if( !b ) {
+        size_t bsize = size > arena->block_size ? size : arena->block_size;
+        b = Malloc( sizeof( struct _ArenaBlock ) + ARENA_ALIGN - 1 + bsize );
+
+        if( !b ) {
+            return 0;
+        }
+
+        b->end = ARENA_FIRST( b ) + bsize;
+
+        if( arena->current ) {
+            b->next = arena->current->next;
+            arena->current->next = b;
+        }
+        else {
+            b->next = arena->head;
+            arena->head = b;
+        }
+
+        arena->nblocks++;
+    }
+
+    arena->current = b;
+    arena->next = ARENA_FIRST( b );
+    arena->end = b->end;
+    return 1;
+}
+
+void *arena_alloc( Arena arena, size_t size )
+{
+    void *ptr = NULL;
+
+    if( size > ( size_t ) - 1 - ARENA_ALIGN ) {
+        return NULL;
+    }
+
+    size = size ? ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) : ARENA_ALIGN;
+    __lock( arena->lock );
+
+    if( ( size_t )( arena->end - arena->next ) >= size ||
+            _arena_next_block( arena, size ) ) {
+        ptr = arena->next;
+        arena->next += size;
+    }
+
+    __unlock( arena->lock );
+    return ptr;
+}
+
+void *arena_calloc( Arena arena, size_t size, size_t n )
+{
+    void *ptr;
+
+    if( n && size > ( size_t ) - 1 / n ) {
+        return NULL;
+    }
+
+    ptr = arena_alloc( arena, size * n );
+
+    if( ptr ) {
+        memset( ptr, 0, size * n );
+    }
+
+    return ptr;
+}
+
+char *arena_strdup( Arena arena, const char *s )
+{
+    size_t size = strlen( s ) + 1;
+    char *dup = arena_alloc( arena, size );
+
+    if( dup ) {
+        memcpy( dup, s, size );
+    }
+
+    return dup;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,63 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "config.h"
+#include "_lock.h"
+
+/*
+ * Bump allocator for short-lived data. Memory is cut from blocks of
+ * 'block_size' bytes (larger requests get own block), there is no per-object
+ * header and no free: all memory is released at once. arena_reset() keeps
+ * all blocks for reuse and takes O(1), arena_destroy() returns them with
+ * Free(). Returned memory is aligned to ARENA_ALIGN.
+ */
+#define ARENA_BLOCK_SIZE    (1024*64)
+#define ARENA_ALIGN         (2*sizeof(void *))
+
+struct _ArenaBlock;
+
+typedef struct _Arena {
+    size_t block_size;
+    struct _ArenaBlock *head;   /* blocks in use order */
+    struct _ArenaBlock *current;
+    char *next;                 /* unused memory of current block */
+    char *end;
+    size_t nblocks;
+    __lock_t( lock );
+} *Arena;
+
+/*
+ * 'block_size' can be 0 (ARENA_BLOCK_SIZE will be used). Return created
+ * arena or NULL.
+ */
+Arena arena_create( size_t block_size );
+void arena_destroy( Arena arena );
+/*
+ * Forget all allocations, all pointers become invalid:
+ */
+void arena_reset( Arena arena );
+/*
+ * Return memory (not initialized) or NULL:
+ */
+void *arena_alloc( Arena arena, size_t size );
+void *arena_calloc( Arena arena, size_t size, size_t n );
+char *arena_strdup( Arena arena, const char *s );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* ARENA_H_ */
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,168 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "chtable.h"
+
+/*
+ * Internal, get stripe for key hash. Hash is mixed once more, so stripe
+ * index does not depend only on the bits used for bucket index and hash
+ * tags inside the stripe.
+ */
+#define CHT_SHARD(cht, hash) \
+    ((cht)->shift < 32 ? \
+     (cht)->shards[((hash) * 0x9E3779B1U) >> (cht)->shift] : \
+     (cht)->shards[0])
+
+/*
+ * Create concurrent hash table. Return created table or NULL.
+ */
+CHTable CHT_create( HT_Hash_Functions hf, size_t nshards, size_t size,
+                    HT_Destructor destructor, HT_Flags flags )
+{
+    size_t i;
+    const CHTable cht = Malloc( sizeof( struct _CHTable ) );
+
+    if( !cht ) {
+        return NULL;
+    }
+
+    if( !nshards ) {
+        nshards = CHT_SHARDS;
+    }
+
+    cht->nshards = 1;
+    cht->shift = 32;
+
+    while( cht->nshards < nshards ) {
+        cht->nshards *= 2;
+        cht->shift--;
+    }
+
+    cht->shards = Calloc( cht->nshards, sizeof( HTable ) );
+
+    if( !cht->shards ) {
+        Free( cht );
+        return NULL;
+    }
+
+    for( i = 0; i < cht->nshards; i++ ) {
+        cht->shards[i] = HT_create_ex( hf, size / cht->nshards, destructor,
+                                       flags );
+
+        if( !cht->shards[i] ) {
+            CHT_destroy( cht );
+            return NULL;
+        }
+
+        /*
+         * Key hash is computed once with the first stripe parameters:
+         */
+        HT_set_seed( cht->shards[i], cht->shards[0]->seed );
+    }
+
+    return cht;
+}
+
+/*
+ * Delete all items:
+ */
+void CHT_clear( const CHTable cht )
+{
+    size_t i;
+
+    for( i = 0; i < cht->nshards; i++ ) {
+        HT_clear( cht->shards[i] );
+    }
+}
+
+/*
+ * Destroy table:
+ */
+void CHT_destroy( const CHTable cht )
+{
+    size_t i;
+
+    for( i = 0; i < cht->nshards; i++ ) {
+        if( cht->shards[i] ) {
+            HT_destroy( cht->shards[i] );
+        }
+    }
+
+    Free( cht->shards );
+    Free( cht );
+}
+
+size_t CHT_nitems( const CHTable cht )
+{
+    size_t i;
+    size_t nitems = 0;
+
+    for( i = 0; i < cht->nshards; i++ ) {
+        nitems += cht->shards[i]->nitems;
+    }
+
+    return nitems;
+}
+
+void CHT_foreach( const CHTable cht, HT_Foreach foreach, void *data )
+{
+    size_t i;
+
+    for( i = 0; i < cht->nshards; i++ ) {
+        HT_foreach( cht->shards[i], foreach, data );
+    }
+}
+
+HTItemConst CHT_set( const CHTable cht, const void *key, size_t key_size,
+                     void *data )
+{
+    unsigned int hash = HT_hash( cht->shards[0], key, key_size );
+    return HT_set_h( CHT_SHARD( cht, hash ), hash, key, key_size, data );
+}
+
+HTItemConst CHT_get( const CHTable cht, const void *key, size_t key_size )
+{
+    unsigned int hash = HT_hash( cht->shards[0], key, key_size );
+    return HT_get_h( CHT_SHARD( cht, hash ), hash, key, key_size );
+}
+
+void const *CHT_val( const CHTable cht, const void *key, size_t key_size )
+{
+    unsigned int hash = HT_hash( cht->shards[0], key, key_size );
+    return HT_val_h( CHT_SHARD( cht, hash ), hash, key, key_size );
+}
+
+int CHT_del( const CHTable cht, const void *key, size_t key_size )
+{
+    unsigned int hash = HT_hash( cht->shards[0], key, key_size );
+    return HT_del_h( CHT_SHARD( cht, hash ), hash, key, key_size );
+}
+
+/*
+ * C-strings keys:
+ */
+HTItemConst CHT_set_c( const CHTable cht, const char *key, void *data )
+{
+    return CHT_set( cht, key, strlen( key ), data );
+}
+
+HTItemConst CHT_get_c( const CHTable cht, const char *key )
+{
+    return CHT_get( cht, key, strlen( key ) );
+}
+
+void const *CHT_val_c( const CHTable cht, const char *key )
+{
+    return CHT_val( cht, key, strlen( key ) );
+}
+
+int CHT_del_c( const CHTable cht, const char *key )
+{
+    return CHT_del( cht, key, strlen( key ) );
+}
+
+/*
+ *  That's All, Folks!
+ */
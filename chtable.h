@@ -0,0 +1,74 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef CHTABLE_H_
+#define CHTABLE_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "htable.h"
+
+/*
+ * Concurrent hash table: keys are spread over 'nshards' independent HTable
+ * stripes by key hash, every stripe has its own lock (USE_LOCKING must be
+ * defined) and is expanded/reduced on its own. Threads working with keys
+ * from different stripes do not wait for each other.
+ */
+#define CHT_SHARDS      64
+
+typedef struct _CHTable {
+    size_t nshards;
+    unsigned int shift;
+    HTable *shards;
+} *CHTable;
+
+/*
+ * 'nshards' will be rounded up to the next highest power of 2, can be 0
+ * (CHT_SHARDS will be used). 'size' is initial size of whole table, other
+ * arguments are the same as for HT_create_ex().
+ */
+CHTable CHT_create( HT_Hash_Functions hf, size_t nshards, size_t size,
+                    HT_Destructor destructor, HT_Flags flags );
+void CHT_clear( const CHTable cht );
+void CHT_destroy( const CHTable cht );
+
+/*
+ * Total items count (not atomic snapshot):
+ */
+size_t CHT_nitems( const CHTable cht );
+/*
+ * Stripes are locked one by one:
+ */
+void CHT_foreach( const CHTable cht, HT_Foreach foreach, void *data );
+
+/*
+ * WARNING: returned HTItemConst can be deleted by another thread, use
+ * CHT_val() to get item data safely.
+ */
+HTItemConst CHT_set( const CHTable cht, const void *key, size_t key_size,
+                     void *data );
+HTItemConst CHT_get( const CHTable cht, const void *key, size_t key_size );
+void const *CHT_val( const CHTable cht, const void *key, size_t key_size );
+/*
+ * Return ENOKEY or 0 (success):
+ */
+int CHT_del( const CHTable cht, const void *key, size_t key_size );
+
+HTItemConst CHT_set_c( const CHTable cht, const char *key, void *data );
+HTItemConst CHT_get_c( const CHTable cht, const char *key );
+void const *CHT_val_c( const CHTable cht, const char *key );
+int CHT_del_c( const CHTable cht, const char *key );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* CHTABLE_H_ */
+
+/*
+ *  That's All, Folks!
+ */
@@ -74,6 +74,11 @@
 # define Free( ptr )            mp_free( NULL, (ptr) )
 # define Munlock( ptr )         mp_unlock( NULL, (ptr) )
 # define Mlock( ptr )           mp_lock( NULL, (ptr) )
+/*
+ * mpool blocks are 4-byte aligned, pointers accessed with __atomic_*()
+ * need their natural alignment:
+ */
+# define Malloc_ptr( size )     mp_alloc_aligned( NULL, (size), sizeof( void * ) )
 #else
 # if defined(__KERNEL__)
 #  include <linux/module.h>
@@ -85,6 +90,7 @@ extern char *_k_strdup( char * );
 #  define Calloc(sz,n)           _k_calloc( (sz), (n) )
 #  define Realloc(ptr,sz)        krealloc( (ptr), (sz), GFP_KERNEL )
 #  define Free(ptr)              kfree( (ptr) )
+#  define Malloc_ptr(sz)         kmalloc( (sz), GFP_KERNEL )
 #  define Munlock( ptr )         (void)ptr
 #  define Mlock( ptr )           (void)ptr
 #  define printf printk
@@ -94,6 +100,7 @@ extern char *_k_strdup( char * );
 #  define Calloc( size, n )      calloc( (size), (n) )
 #  define Realloc( src, n )      realloc( (src), (n) )
 #  define Free( ptr )            free( (ptr) )
+#  define Malloc_ptr( size )     malloc( (size) )
 #  define Munlock( ptr )         (void)ptr
 #  define Mlock( ptr )           (void)ptr
 # endif
@@ -10,14 +10,58 @@
 
 #include <string.h>
 
+/*
+ * Streaming: crc = crc16_init(); crc = crc16_update( crc, buf, len ) for
+ * every chunk; result = crc16_final( crc ) (same as xcrc16() of whole data).
+ */
 unsigned short crc16( const void *buf, size_t len );
+unsigned short crc16_update( unsigned short crc, const void *buf, size_t len );
+#define crc16_init() ( ( unsigned short ) 0xFFFF )
+#define crc16_final(crc) ( ( unsigned short ) ( (crc) ^ 0xFFFF ) )
 #define scrc16(buf) crc16( (buf),strlen( (buf) ) )
 #define xcrc16(buf) ( crc16( (buf),strlen( (buf) ) ) ^ 0xFFFF )
 #define xscrc16(buf) ( scrc16( (buf) ) ^ 0xFFFF )
 
+/*
+ * CRC32 functions return CRC register without final xor (see xcrc32()).
+ * Slicing-by-8 tables, PCLMULQDQ folding (x86) or ARMv8 CRC instructions
+ * are selected at runtime. To continue CRC pass previous result to
+ * _update() function:
+ *   crc32( buf, len ) == crc32_update( 0xFFFFFFFF, buf, len )
+ *   crc32_update( crc32( a, alen ), b, blen ) == CRC of 'a' followed by 'b'
+ */
 unsigned int crc32( const void *buf, size_t len );
+unsigned int crc32_update( unsigned int crc, const void *buf, size_t len );
 #define scrc32(buf) crc32( (buf),strlen( (buf) ) )
 #define xcrc32(buf) ( crc32( (buf),strlen( (buf) ) ) ^ 0xFFFFFFFF)
 #define xscrc32(buf) ( scrc32( (buf) ) ^ 0xFFFFFFFF)
 
+/*
+ * Streaming: crc = crc32_init(); crc = crc32_update( crc, buf, len ) for
+ * every chunk; result = crc32_final( crc ) (same as xcrc32() of whole data).
+ */
+#define crc32_init() 0xFFFFFFFFU
+#define crc32_final(crc) ( (crc) ^ 0xFFFFFFFFU )
+/*
+ * Return final CRC of 'A' followed by 'B' given final CRCs of both and
+ * length of 'B', in O(log(lenB)) time. Chunks of large data can be checked
+ * in parallel and combined in order.
+ */
+unsigned int crc32_combine( unsigned int crcA, unsigned int crcB,
+                            unsigned long long lenB );
+
+/*
+ * CRC32C (Castagnoli polynomial), SSE4.2 or ARMv8 crc32c instructions when
+ * available:
+ */
+unsigned int crc32c( const void *buf, size_t len );
+unsigned int crc32c_update( unsigned int crc, const void *buf, size_t len );
+#define scrc32c(buf) crc32c( (buf),strlen( (buf) ) )
+#define xcrc32c(buf) ( crc32c( (buf),strlen( (buf) ) ) ^ 0xFFFFFFFF)
+#define xscrc32c(buf) ( scrc32c( (buf) ) ^ 0xFFFFFFFF)
+#define crc32c_init() crc32_init()
+#define crc32c_final(crc) crc32_final( (crc) )
+unsigned int crc32c_combine( unsigned int crcA, unsigned int crcB,
+                             unsigned long long lenB );
+
 #endif /* CRC_H_ */
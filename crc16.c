@@ -42,8 +42,12 @@ _crc_16_table[256] = {
 
 unsigned short crc16( const void *buf, size_t len )
 {
-    unsigned short crc = 0xFFFF;
-    const char *_buf = buf;
+    return crc16_update( 0xFFFF, buf, len );
+}
+
+unsigned short crc16_update( unsigned short crc, const void *buf, size_t len )
+{
+    const unsigned char *_buf = buf;
 
     while( len-- ) {
         crc = _crc_16_table[( ( crc >> 8 ) ^ *_buf++ ) & 0xFF] ^ ( crc << 8 );
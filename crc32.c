@@ -5,6 +5,22 @@
  *      Author: Vsevolod Lutovinov <klopp@yandex.ru>
  */
 #include "crc.h"
+#include <stdint.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+# define CRC_X86
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+# define CRC_ARM
+# include <arm_acle.h>
+#endif
+
+#if defined(USE_LOCKING) && defined(__unix__)
+# define CRC_ONCE
+# include <pthread.h>
+#endif
+
+#define CRC32C_POLY     0x82F63B78
 
 static unsigned int _crc_32_table[256] = {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
@@ -73,15 +89,431 @@ static unsigned int _crc_32_table[256] = {
     0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-unsigned int crc32( const void *buf, size_t len )
+/*
+ * Slicing-by-8 tables (table 'n' gives CRC of byte followed by 'n' zero
+ * bytes), built on first use:
+ */
+static uint32_t _crc32_slice[8][256];
+static uint32_t _crc32c_slice[8][256];
+
+static void _crc_slice_init( uint32_t slice[8][256], const unsigned int *table,
+                             uint32_t poly )
+{
+    unsigned int i, j;
+
+    for( i = 0; i < 256; i++ ) {
+        uint32_t c = i;
+
+        if( table ) {
+            c = table[i];
+        }
+        else {
+            for( j = 0; j < 8; j++ ) {
+                c = ( c >> 1 ) ^ ( ( c & 1 ) ? poly : 0 );
+            }
+        }
+
+        slice[0][i] = c;
+    }
+
+    for( i = 0; i < 256; i++ ) {
+        for( j = 1; j < 8; j++ ) {
+            slice[j][i] = ( slice[j - 1][i] >> 8 ) ^
+                          slice[0][slice[j - 1][i] & 0xFF];
+        }
+    }
+}
+
+/*
+ * Internal, software kernel: 8 bytes per iteration.
+ */
+static uint32_t _crc_slice8( uint32_t slice[8][256], uint32_t crc,
+                             const unsigned char *p, size_t len )
+{
+    while( len >= 8 ) {
+        uint32_t lo = crc ^ ( p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) |
+                              ( ( uint32_t ) p[3] << 24 ) );
+        uint32_t hi = p[4] | ( p[5] << 8 ) | ( p[6] << 16 ) |
+                      ( ( uint32_t ) p[7] << 24 );
+        crc = slice[7][lo & 0xFF] ^ slice[6][( lo >> 8 ) & 0xFF] ^
+              slice[5][( lo >> 16 ) & 0xFF] ^ slice[4][lo >> 24] ^
+              slice[3][hi & 0xFF] ^ slice[2][( hi >> 8 ) & 0xFF] ^
+              slice[1][( hi >> 16 ) & 0xFF] ^ slice[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+
+    while( len-- ) {
+        crc = ( crc >> 8 ) ^ slice[0][( crc ^ *p++ ) & 0xFF];
+    }
+
+    return crc;
+}
+
+static uint32_t _crc32_soft( uint32_t crc, const unsigned char *p,
+                             size_t len )
+{
+    return _crc_slice8( _crc32_slice, crc, p, len );
+}
+
+static uint32_t _crc32c_soft( uint32_t crc, const unsigned char *p,
+                              size_t len )
+{
+    return _crc_slice8( _crc32c_slice, crc, p, len );
+}
+
+#if defined(CRC_X86)
+
+/*
+ * CRC32 folding with carry-less multiplication ("Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction", Intel, 2009), bit
+ * reflected constants for 0xEDB88320. Four 128-bit lanes are folded by 64
+ * bytes, then to one lane, to 64 bits and Barrett reduced to 32 bits.
+ * 'len' must be >= 64 and multiple of 16.
+ */
+__attribute__( ( target( "pclmul,sse4.1" ) ) )
+static uint32_t _crc32_fold( uint32_t crc, const unsigned char *p,
+                             size_t len )
 {
-    unsigned int crc = 0xFFFFFFFF;
-    const char *_buf = buf;
+    static const uint64_t k1k2[2] __attribute__( ( aligned( 16 ) ) ) = {
+        0x0154442bd4ULL, 0x01c6e41596ULL
+    };
+    static const uint64_t k3k4[2] __attribute__( ( aligned( 16 ) ) ) = {
+        0x01751997d0ULL, 0x00ccaa009eULL
+    };
+    static const uint64_t k5k0[2] __attribute__( ( aligned( 16 ) ) ) = {
+        0x0163cd6124ULL, 0x0000000000ULL
+    };
+    static const uint64_t poly[2] __attribute__( ( aligned( 16 ) ) ) = {
+        0x01db710641ULL, 0x01f7011641ULL
+    };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128( ( const __m128i * )( p + 0x00 ) );
+    x2 = _mm_loadu_si128( ( const __m128i * )( p + 0x10 ) );
+    x3 = _mm_loadu_si128( ( const __m128i * )( p + 0x20 ) );
+    x4 = _mm_loadu_si128( ( const __m128i * )( p + 0x30 ) );
+    x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( crc ) );
+    x0 = _mm_load_si128( ( const __m128i * ) k1k2 );
+    p += 64;
+    len -= 64;
+
+    while( len >= 64 ) {
+        x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+        x6 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+        x7 = _mm_clmulepi64_si128( x3, x0, 0x00 );
+        x8 = _mm_clmulepi64_si128( x4, x0, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+        x2 = _mm_clmulepi64_si128( x2, x0, 0x11 );
+        x3 = _mm_clmulepi64_si128( x3, x0, 0x11 );
+        x4 = _mm_clmulepi64_si128( x4, x0, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ),
+                            _mm_loadu_si128( ( const __m128i * )( p + 0x00 ) ) );
+        x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ),
+                            _mm_loadu_si128( ( const __m128i * )( p + 0x10 ) ) );
+        x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ),
+                            _mm_loadu_si128( ( const __m128i * )( p + 0x20 ) ) );
+        x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ),
+                            _mm_loadu_si128( ( const __m128i * )( p + 0x30 ) ) );
+        p += 64;
+        len -= 64;
+    }
+
+    /*
+     * Fold into 128 bits:
+     */
+    x0 = _mm_load_si128( ( const __m128i * ) k3k4 );
+    x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+    while( len >= 16 ) {
+        x2 = _mm_loadu_si128( ( const __m128i * ) p );
+        x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+        p += 16;
+        len -= 16;
+    }
+
+    /*
+     * Fold 128 bits to 64 bits:
+     */
+    x2 = _mm_clmulepi64_si128( x1, x0, 0x10 );
+    x3 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+    x1 = _mm_srli_si128( x1, 8 );
+    x1 = _mm_xor_si128( x1, x2 );
+    x0 = _mm_loadl_epi64( ( const __m128i * ) k5k0 );
+    x2 = _mm_srli_si128( x1, 4 );
+    x1 = _mm_and_si128( x1, x3 );
+    x1 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    /*
+     * Barrett reduction to 32 bits:
+     */
+    x0 = _mm_load_si128( ( const __m128i * ) poly );
+    x2 = _mm_and_si128( x1, x3 );
+    x2 = _mm_clmulepi64_si128( x2, x0, 0x10 );
+    x2 = _mm_and_si128( x2, x3 );
+    x2 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+    return _mm_extract_epi32( x1, 1 );
+}
+
+static uint32_t _crc32_pclmul( uint32_t crc, const unsigned char *p,
+                               size_t len )
+{
+    if( len >= 64 ) {
+        size_t n = len & ~( size_t ) 15;
+        crc = _crc32_fold( crc, p, n );
+        p += n;
+        len -= n;
+    }
+
+    return _crc_slice8( _crc32_slice, crc, p, len );
+}
+
+/*
+ * CRC32C with SSE4.2 crc32 instruction:
+ */
+__attribute__( ( target( "sse4.2" ) ) )
+static uint32_t _crc32c_sse42( uint32_t crc, const unsigned char *p,
+                               size_t len )
+{
+#if defined(__x86_64__)
+    uint64_t c = crc;
+
+    while( len >= 8 ) {
+        uint64_t v;
+        memcpy( &v, p, 8 );
+        c = _mm_crc32_u64( c, v );
+        p += 8;
+        len -= 8;
+    }
+
+    crc = ( uint32_t ) c;
+#endif
+
+    while( len >= 4 ) {
+        uint32_t v;
+        memcpy( &v, p, 4 );
+        crc = _mm_crc32_u32( crc, v );
+        p += 4;
+        len -= 4;
+    }
+
+    while( len-- ) {
+        crc = _mm_crc32_u8( crc, *p++ );
+    }
+
+    return crc;
+}
+
+#elif defined(CRC_ARM)
+
+/*
+ * ARMv8 CRC32 extension (both polynomials):
+ */
+static uint32_t _crc32_arm( uint32_t crc, const unsigned char *p,
+                            size_t len )
+{
+    while( len >= 8 ) {
+        uint64_t v;
+        memcpy( &v, p, 8 );
+        crc = __crc32d( crc, v );
+        p += 8;
+        len -= 8;
+    }
 
     while( len-- ) {
-        crc = ( crc >> 8 ) ^ _crc_32_table[( crc ^ *_buf++ ) & 0xFF];
+        crc = __crc32b( crc, *p++ );
     }
 
     return crc;
 }
 
+static uint32_t _crc32c_arm( uint32_t crc, const unsigned char *p,
+                             size_t len )
+{
+    while( len >= 8 ) {
+        uint64_t v;
+        memcpy( &v, p, 8 );
+        crc = __crc32cd( crc, v );
+        p += 8;
+        len -= 8;
+    }
+
+    while( len-- ) {
+        crc = __crc32cb( crc, *p++ );
+    }
+
+    return crc;
+}
+
+#endif
+
+/*
+ * Implementations are selected at first call. Slicing tables are built
+ * once (pthread_once() with USE_LOCKING) before the kernel is published,
+ * threads which see the kernel see complete tables:
+ */
+typedef uint32_t ( *_crc_kernel )( uint32_t crc, const unsigned char *p,
+                                   size_t len );
+
+static uint32_t _crc32_select( uint32_t crc, const unsigned char *p,
+                               size_t len );
+static uint32_t _crc32c_select( uint32_t crc, const unsigned char *p,
+                                size_t len );
+static _crc_kernel _crc32_kernel = _crc32_select;
+static _crc_kernel _crc32c_kernel = _crc32c_select;
+#if defined(CRC_ONCE)
+static pthread_once_t _crc32_once = PTHREAD_ONCE_INIT;
+static pthread_once_t _crc32c_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void _crc32_init( void )
+{
+    _crc_kernel kernel = _crc32_soft;
+    _crc_slice_init( _crc32_slice, _crc_32_table, 0 );
+#if defined(CRC_X86)
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "pclmul" ) &&
+            __builtin_cpu_supports( "sse4.1" ) ) {
+        kernel = _crc32_pclmul;
+    }
+
+#elif defined(CRC_ARM)
+    kernel = _crc32_arm;
+#endif
+    __atomic_store_n( &_crc32_kernel, kernel, __ATOMIC_RELEASE );
+}
+
+static void _crc32c_init( void )
+{
+    _crc_kernel kernel = _crc32c_soft;
+    _crc_slice_init( _crc32c_slice, NULL, CRC32C_POLY );
+#if defined(CRC_X86)
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "sse4.2" ) ) {
+        kernel = _crc32c_sse42;
+    }
+
+#elif defined(CRC_ARM)
+    kernel = _crc32c_arm;
+#endif
+    __atomic_store_n( &_crc32c_kernel, kernel, __ATOMIC_RELEASE );
+}
+
+static uint32_t _crc32_select( uint32_t crc, const unsigned char *p,
+                               size_t len )
+{
+#if defined(CRC_ONCE)
+    pthread_once( &_crc32_once, _crc32_init );
+#else
+    _crc32_init();
+#endif
+    return __atomic_load_n( &_crc32_kernel, __ATOMIC_ACQUIRE )( crc, p, len );
+}
+
+static uint32_t _crc32c_select( uint32_t crc, const unsigned char *p,
+                                size_t len )
+{
+#if defined(CRC_ONCE)
+    pthread_once( &_crc32c_once, _crc32c_init );
+#else
+    _crc32c_init();
+#endif
+    return __atomic_load_n( &_crc32c_kernel, __ATOMIC_ACQUIRE )( crc, p, len );
+}
+
+unsigned int crc32( const void *buf, size_t len )
+{
+    return crc32_update( 0xFFFFFFFF, buf, len );
+}
+
+unsigned int crc32_update( unsigned int crc, const void *buf, size_t len )
+{
+    _crc_kernel kernel = __atomic_load_n( &_crc32_kernel, __ATOMIC_ACQUIRE );
+    return kernel( crc, buf, len );
+}
+
+unsigned int crc32c( const void *buf, size_t len )
+{
+    return crc32c_update( 0xFFFFFFFF, buf, len );
+}
+
+unsigned int crc32c_update( unsigned int crc, const void *buf, size_t len )
+{
+    _crc_kernel kernel = __atomic_load_n( &_crc32c_kernel, __ATOMIC_ACQUIRE );
+    return kernel( crc, buf, len );
+}
+
+/*
+ * Internal, a * b modulo reflected 'poly' (bit 31 is x^0).
+ */
+static uint32_t _crc_multmodp( uint32_t a, uint32_t b, uint32_t poly )
+{
+    uint32_t m = 1U << 31;
+    uint32_t p = 0;
+
+    while( m ) {
+        if( a & m ) {
+            p ^= b;
+
+            if( !( a & ( m - 1 ) ) ) {
+                break;
+            }
+        }
+
+        m >>= 1;
+        b = ( b & 1 ) ? ( b >> 1 ) ^ poly : b >> 1;
+    }
+
+    return p;
+}
+
+/*
+ * Internal, CRC of 'A' followed by 'B' is CRC(A) * x^(8 * lenB) + CRC(B)
+ * (zlib's crc32_combine()), x^(8 * lenB) is computed by repeated squaring.
+ */
+static uint32_t _crc_combine( uint32_t crcA, uint32_t crcB,
+                              unsigned long long lenB, uint32_t poly )
+{
+    uint32_t x = 1U << 23;
+    uint32_t p = 1U << 31;
+
+    while( lenB ) {
+        if( lenB & 1 ) {
+            p = _crc_multmodp( x, p, poly );
+        }
+
+        lenB >>= 1;
+
+        if( lenB ) {
+            x = _crc_multmodp( x, x, poly );
+        }
+    }
+
+    return _crc_multmodp( p, crcA, poly ) ^ crcB;
+}
+
+unsigned int crc32_combine( unsigned int crcA, unsigned int crcB,
+                            unsigned long long lenB )
+{
+    return _crc_combine( crcA, crcB, lenB, 0xEDB88320 );
+}
+
+unsigned int crc32c_combine( unsigned int crcA, unsigned int crcB,
+                             unsigned long long lenB )
+{
+    return _crc_combine( crcA, crcB, lenB, CRC32C_POLY );
+}
@@ -0,0 +1,224 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "ebr.h"
+
+#if defined(EBR_ENABLED)
+
+#include "_lock.h"
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Try to advance global epoch every EBR_COLLECT retired pointers:
+ */
+#define EBR_COLLECT     64
+
+/*
+ * Per-thread record, state is ((epoch << 1) | 1) inside read-side critical
+ * section and 0 outside. Records are never freed, record of exited thread
+ * is reused by new one.
+ */
+typedef struct _ebr_thread {
+    unsigned long state;
+    int used;
+    struct _ebr_thread *next;
+} *ebr_thread;
+
+typedef struct _ebr_node {
+    void *ptr;
+    ebr_free fn;
+    void *arg;
+    struct _ebr_node *next;
+} *ebr_node;
+
+static ebr_thread _ebr_threads = NULL;
+static unsigned long _ebr_epoch = 0;
+static ebr_node _ebr_limbo[3] = { NULL, NULL, NULL };
+static size_t _ebr_retired = 0;
+static __lock_type _ebr_lock;
+static pthread_once_t _ebr_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _ebr_key;
+static __thread ebr_thread _ebr_self = NULL;
+static __thread size_t _ebr_nest = 0;
+
+/*
+ * Internal, thread exit handler: release thread record.
+ */
+static void _ebr_release( void *ptr )
+{
+    ebr_thread t = ptr;
+    __atomic_store_n( &t->state, 0, __ATOMIC_RELEASE );
+    __atomic_store_n( &t->used, 0, __ATOMIC_RELEASE );
+}
+
+static void _ebr_init( void )
+{
+    __initlock( _ebr_lock );
+    pthread_key_create( &_ebr_key, _ebr_release );
+}
+
+/*
+ * Internal, get free thread record or create new one.
+ */
+static ebr_thread _ebr_register( void )
+{
+    ebr_thread t;
+    pthread_once( &_ebr_once, _ebr_init );
+    __lock( _ebr_lock );
+
+    for( t = _ebr_threads; t; t = t->next ) {
+        if( !t->used ) {
+            break;
+        }
+    }
+
+    if( !t ) {
+        t = Malloc_ptr( sizeof( struct _ebr_thread ) );
+
+        if( !t ) {
+            __unlock( _ebr_lock );
+            return NULL;
+        }
+
+        memset( t, 0, sizeof( struct _ebr_thread ) );
+
+        t->next = _ebr_threads;
+        __atomic_store_n( &_ebr_threads, t, __ATOMIC_RELEASE );
+    }
+
+    t->used = 1;
+    __unlock( _ebr_lock );
+    pthread_setspecific( _ebr_key, t );
+    _ebr_self = t;
+    return t;
+}
+
+/*
+ * Internal, advance global epoch if all active readers have seen current
+ * one. Must be called with _ebr_lock held. Return 1 (success) or 0, '*list'
+ * is set to data retired two epochs ago (safe to free).
+ */
+static int _ebr_advance( ebr_node *list )
+{
+    ebr_thread t;
+    unsigned long epoch = _ebr_epoch;
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    for( t = _ebr_threads; t; t = t->next ) {
+        unsigned long state = __atomic_load_n( &t->state, __ATOMIC_ACQUIRE );
+
+        if( ( state & 1 ) && ( state >> 1 ) != epoch ) {
+            return 0;
+        }
+    }
+
+    __atomic_store_n( &_ebr_epoch, epoch + 1, __ATOMIC_SEQ_CST );
+    *list = _ebr_limbo[( epoch + 2 ) % 3];
+    _ebr_limbo[( epoch + 2 ) % 3] = NULL;
+    return 1;
+}
+
+static void _ebr_free_list( ebr_node list )
+{
+    while( list ) {
+        ebr_node next = list->next;
+        list->fn( list->ptr, list->arg );
+        Free( list );
+        list = next;
+    }
+}
+
+/*
+ * Enter read-side critical section. Return 1 (success) or 0 (no memory
+ * for thread record).
+ */
+int ebr_enter( void )
+{
+    ebr_thread t = _ebr_self;
+
+    if( !t && !( t = _ebr_register() ) ) {
+        return 0;
+    }
+
+    if( !_ebr_nest++ ) {
+        __atomic_store_n( &t->state,
+                          ( __atomic_load_n( &_ebr_epoch, __ATOMIC_ACQUIRE ) << 1 ) | 1,
+                          __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    }
+
+    return 1;
+}
+
+void ebr_leave( void )
+{
+    if( _ebr_nest && !--_ebr_nest ) {
+        __atomic_store_n( &_ebr_self->state, 0, __ATOMIC_RELEASE );
+    }
+}
+
+/*
+ * Retire pointer. If memory for retire record can not be allocated 'ptr'
+ * is leaked rather than freed unsafely.
+ */
+void ebr_retire( void *ptr, ebr_free fn, void *arg )
+{
+    ebr_node list = NULL;
+    ebr_node node = Malloc( sizeof( struct _ebr_node ) );
+
+    if( !node ) {
+        return;
+    }
+
+    node->ptr = ptr;
+    node->fn = fn;
+    node->arg = arg;
+    pthread_once( &_ebr_once, _ebr_init );
+    __lock( _ebr_lock );
+    node->next = _ebr_limbo[_ebr_epoch % 3];
+    _ebr_limbo[_ebr_epoch % 3] = node;
+
+    if( ++_ebr_retired >= EBR_COLLECT ) {
+        _ebr_retired = 0;
+        _ebr_advance( &list );
+    }
+
+    __unlock( _ebr_lock );
+    _ebr_free_list( list );
+}
+
+/*
+ * Wait for all readers and free all retired data:
+ */
+void ebr_synchronize( void )
+{
+    int advanced = 0;
+    pthread_once( &_ebr_once, _ebr_init );
+
+    while( advanced < 3 ) {
+        ebr_node list = NULL;
+        __lock( _ebr_lock );
+
+        if( _ebr_advance( &list ) ) {
+            advanced++;
+        }
+
+        __unlock( _ebr_lock );
+
+        if( list ) {
+            _ebr_free_list( list );
+        }
+        else if( advanced < 3 ) {
+            sched_yield();
+        }
+    }
+}
+
+#endif
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,56 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef EBR_H_
+#define EBR_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "config.h"
+
+/*
+ * Epoch based memory reclamation. Readers wrap access to shared data with
+ * ebr_enter()/ebr_leave(): can be nested, never blocks, ebr_enter() return
+ * 0 if thread record can not be allocated. Writers unlink data and pass it
+ * to ebr_retire(): 'fn( ptr, arg )' will be called when no reader can hold
+ * 'ptr' anymore, i.e. all threads which were inside read-side critical
+ * section at the moment of ebr_retire() have left it.
+ *
+ * ebr_synchronize() waits for all readers and frees all retired data, it
+ * must not be called from read-side critical section.
+ *
+ * Without USE_LOCKING (single thread) retired data is freed at once.
+ */
+typedef void ( *ebr_free )( void *ptr, void *arg );
+
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+
+# define EBR_ENABLED
+
+int ebr_enter( void );
+void ebr_leave( void );
+void ebr_retire( void *ptr, ebr_free fn, void *arg );
+void ebr_synchronize( void );
+
+#else
+
+# define ebr_enter()                1
+# define ebr_leave()                (void)0
+# define ebr_retire(ptr, fn, arg)   (fn)( (ptr), (arg) )
+# define ebr_synchronize()          (void)0
+
+#endif
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* EBR_H_ */
+
+/*
+ *  That's All, Folks!
+ */
@@ -35,6 +35,30 @@ unsigned shash_rot13_update( unsigned startval, const char *buf );
 unsigned shash_ly_update( unsigned startval, const char *buf );
 unsigned shash_rs_update( unsigned startval, const char *buf );
 
+/*
+ * hash_rs() multiplier depends on the position in data, _update() calls
+ * restart it, so hash_rs_update( hash_rs( x ), y ) != hash_rs( x + y ).
+ * To hash data by parts keep the multiplier in 'a' (set it to 0 before the
+ * first part):
+ *
+ *      unsigned a = 0;
+ *      unsigned hash = hash_rs_update_r( 0, x, x_size, &a );
+ *      hash = hash_rs_update_r( hash, y, y_size, &a );
+ */
+unsigned hash_rs_update_r( unsigned startval, const void *buf, size_t size,
+                           unsigned *a );
+unsigned shash_rs_update_r( unsigned startval, const char *buf, unsigned *a );
+
+/*
+ * 64-bit word-at-a-time hash (wyhash), 'startval' is the seed:
+ */
+unsigned long long hash_wy( const void *buf, size_t size );
+unsigned long long hash_wy_update( unsigned long long startval,
+                                   const void *buf, size_t size );
+unsigned long long shash_wy( const char *buf );
+unsigned long long shash_wy_update( unsigned long long startval,
+                                    const char *buf );
+
 #ifdef __cplusplus
 }
 #endif
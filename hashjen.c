@@ -7,8 +7,6 @@
 
 #include "hash.h"
 
-static unsigned hash = 0;
-
 unsigned hash_jen( const void *buf, size_t size )
 {
     return hash_jen_update( 0, buf, size );
@@ -21,6 +19,8 @@ unsigned shash_jen( const char *buf )
 
 unsigned hash_jen_update( unsigned startval, const void *buf, size_t size )
 {
+    unsigned hash;
+
     for( hash = startval; size; size-- ) {
         hash += *( ( unsigned char * ) buf );
         hash += ( hash << 10 );
@@ -36,6 +36,8 @@ unsigned hash_jen_update( unsigned startval, const void *buf, size_t size )
 
 unsigned shash_jen_update( unsigned startval, const char *buf )
 {
+    unsigned hash;
+
     for( hash = startval; *buf; buf++ ) {
         hash += *( ( unsigned char * ) buf );
         hash += ( hash << 10 );
@@ -10,8 +10,6 @@
 #define A   1664525
 #define B   1013904223
 
-static unsigned hash = 0;
-
 unsigned hash_ly( const void *buf, size_t size )
 {
     return hash_ly_update( 0, buf, size );
@@ -24,6 +22,8 @@ unsigned shash_ly( const char *buf )
 
 unsigned hash_ly_update( unsigned startval, const void *buf, size_t size )
 {
+    unsigned hash;
+
     for( hash = startval; size; size-- ) {
         hash = ( hash * A ) + *( ( unsigned char * ) buf ) + B;
         buf = ( unsigned char * ) buf + 1;
@@ -34,6 +34,8 @@ unsigned hash_ly_update( unsigned startval, const void *buf, size_t size )
 
 unsigned shash_ly_update( unsigned startval, const char *buf )
 {
+    unsigned hash;
+
     for( hash = startval; *buf; buf++ ) {
         hash = ( hash * A ) + *( ( unsigned char * ) buf ) + B;
     }
@@ -7,8 +7,6 @@
 
 #include "hash.h"
 
-static unsigned hash = 0;
-
 unsigned hash_rot13( const void *buf, size_t size )
 {
     return hash_rot13_update( 0, buf, size );
@@ -21,6 +19,8 @@ unsigned shash_rot13( const char *buf )
 
 unsigned hash_rot13_update( unsigned startval, const void *buf, size_t size )
 {
+    unsigned hash;
+
     for( hash = startval; size; size-- ) {
         hash += *( ( unsigned char * ) buf );
         hash -= ( hash << 13 ) | ( hash >> 19 );
@@ -32,6 +32,8 @@ unsigned hash_rot13_update( unsigned startval, const void *buf, size_t size )
 
 unsigned shash_rot13_update( unsigned startval, const char *buf )
 {
+    unsigned hash;
+
     for( hash = startval; *buf; buf++ ) {
         hash += *( ( unsigned char * ) buf );
         hash -= ( hash << 13 ) | ( hash >> 19 );
@@ -10,9 +10,6 @@
 #define A   63689
 #define B   378551
 
-static unsigned a = 0;
-static unsigned hash = 0;
-
 unsigned hash_rs( const void *buf, size_t size )
 {
     return hash_rs_update( 0, buf, size );
@@ -25,30 +22,46 @@ unsigned shash_rs( const char *buf )
 
 unsigned hash_rs_update( unsigned startval, const void *buf, size_t size )
 {
-    if( !startval ) {
-        a = A;
+    unsigned a = 0;
+    return hash_rs_update_r( startval, buf, size, &a );
+}
+
+unsigned shash_rs_update( unsigned startval, const char *buf )
+{
+    unsigned a = 0;
+    return shash_rs_update_r( startval, buf, &a );
+}
+
+unsigned hash_rs_update_r( unsigned startval, const void *buf, size_t size,
+                           unsigned *a )
+{
+    unsigned hash;
+
+    if( !*a ) {
+        *a = A;
     }
 
     for( hash = startval; size; size-- ) {
-        hash = hash * a + *( ( unsigned char * ) buf );
-        a *= B;
+        hash = hash * *a + *( ( unsigned char * ) buf );
+        *a *= B;
         buf = ( unsigned char * ) buf + 1;
     }
 
     return hash;
 }
 
-unsigned shash_rs_update( unsigned startval, const char *buf )
+unsigned shash_rs_update_r( unsigned startval, const char *buf, unsigned *a )
 {
-    if( !startval ) {
-        a = A;
+    unsigned hash;
+
+    if( !*a ) {
+        *a = A;
     }
 
     for( hash = startval; *buf; buf++ ) {
-        hash = hash * a + *( ( unsigned char * ) buf );
-        a *= B;
+        hash = hash * *a + *( ( unsigned char * ) buf );
+        *a *= B;
     }
 
     return hash;
 }
-
@@ -0,0 +1,138 @@
+/*
+ * hashwy.c, part of "klib" project.
+ *
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "hash.h"
+#include <stdint.h>
+
+/*
+ * wyhash (final version 4, public domain, Wang Yi): 8 bytes per step, 48
+ * bytes per loop iteration with three independent lanes, 64-bit result.
+ * Keys are read in native byte order, so hash values differ between big-
+ * and little-endian machines.
+ */
+static const uint64_t _wyp[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/*
+ * 64x64 -> 128 bits multiplication, low half to '*a', high half to '*b':
+ */
+static inline void _wymum( uint64_t *a, uint64_t *b )
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = ( uint64_t ) r;
+    *b = ( uint64_t )( r >> 64 );
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = ( uint32_t ) * a, lb = ( uint32_t ) * b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + ( rm0 << 32 ), c = t < rl;
+    uint64_t lo = t + ( rm1 << 32 );
+    c += lo < t;
+    *a = lo;
+    *b = rh + ( rm0 >> 32 ) + ( rm1 >> 32 ) + c;
+#endif
+}
+
+static inline uint64_t _wymix( uint64_t a, uint64_t b )
+{
+    _wymum( &a, &b );
+    return a ^ b;
+}
+
+static inline uint64_t _wyr8( const unsigned char *p )
+{
+    uint64_t v;
+    memcpy( &v, p, 8 );
+    return v;
+}
+
+static inline uint64_t _wyr4( const unsigned char *p )
+{
+    uint32_t v;
+    memcpy( &v, p, 4 );
+    return v;
+}
+
+static inline uint64_t _wyr3( const unsigned char *p, size_t k )
+{
+    return ( ( ( uint64_t ) p[0] ) << 16 ) | ( ( ( uint64_t ) p[k >> 1] ) << 8 ) |
+           p[k - 1];
+}
+
+unsigned long long hash_wy( const void *buf, size_t size )
+{
+    return hash_wy_update( 0, buf, size );
+}
+
+unsigned long long shash_wy( const char *buf )
+{
+    return hash_wy_update( 0, buf, strlen( buf ) );
+}
+
+unsigned long long shash_wy_update( unsigned long long startval,
+                                    const char *buf )
+{
+    return hash_wy_update( startval, buf, strlen( buf ) );
+}
+
+unsigned long long hash_wy_update( unsigned long long startval,
+                                   const void *buf, size_t size )
+{
+    const unsigned char *p = buf;
+    uint64_t seed = startval ^ _wymix( startval ^ _wyp[0], _wyp[1] );
+    uint64_t a, b;
+
+    if( size <= 16 ) {
+        if( size >= 4 ) {
+            a = ( _wyr4( p ) << 32 ) | _wyr4( p + ( ( size >> 3 ) << 2 ) );
+            b = ( _wyr4( p + size - 4 ) << 32 ) |
+                _wyr4( p + size - 4 - ( ( size >> 3 ) << 2 ) );
+        }
+        else if( size ) {
+            a = _wyr3( p, size );
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = size;
+
+        if( i > 48 ) {
+            uint64_t see1 = seed, see2 = seed;
+
+            do {
+                seed = _wymix( _wyr8( p ) ^ _wyp[1], _wyr8( p + 8 ) ^ seed );
+                see1 = _wymix( _wyr8( p + 16 ) ^ _wyp[2], _wyr8( p + 24 ) ^ see1 );
+                see2 = _wymix( _wyr8( p + 32 ) ^ _wyp[3], _wyr8( p + 40 ) ^ see2 );
+                p += 48;
+                i -= 48;
+            } while( i > 48 );
+
+            seed ^= see1 ^ see2;
+        }
+
+        while( i > 16 ) {
+            seed = _wymix( _wyr8( p ) ^ _wyp[1], _wyr8( p + 8 ) ^ seed );
+            i -= 16;
+            p += 16;
+        }
+
+        a = _wyr8( p + i - 16 );
+        b = _wyr8( p + i - 8 );
+    }
+
+    a ^= _wyp[1];
+    b ^= seed;
+    _wymum( &a, &b );
+    return _wymix( a ^ _wyp[0] ^ size, b ^ _wyp[1] );
+}
@@ -6,10 +6,48 @@
 #include "htable.h"
 #include "crc.h"
 #include "hash.h"
+#include <time.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+# define HT_SIMD
+# include <immintrin.h>
+#endif
 
 #define HT_HASH_MASK(ht)    (ht->size-1)
 #define QSORT_STACK_SIZE    128
 #define ISORT_LIMIT         128
+/*
+ * Parallel sort: arrays of PSORT_LIMIT or more items are split between up
+ * to PSORT_MAX_THREADS threads (USE_LOCKING only):
+ */
+#define PSORT_LIMIT         (1024*64)
+#define PSORT_MAX_THREADS   8
+
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+# define HT_PSORT
+#endif
+
+/*
+ * HTF_FLAT control bytes: 7-bit hash tag for used slots, special values
+ * (high bit set) for empty and deleted ones:
+ */
+#define HT_CTRL_EMPTY       0x80
+#define HT_CTRL_DELETED     0xFE
+#define HT_CTRL_TAG(hash)   ((unsigned char)((hash) >> 25))
+#define HT_CTRL_FULL(c)     (!((c) & 0x80))
+#define HT_GROUP_MAX        32
+#define HT_FLAT_MAX_LOAD(size)  ((size) - (size) / 8)
+#define HT_NO_SLOT          ((size_t)-1)
+/*
+ * HT_get_many()/HT_set_many(): keys are hashed and prefetched by chunks:
+ */
+#define HT_BATCH            32
+
+#if defined(__GNUC__)
+# define HT_PREFETCH(ptr)   __builtin_prefetch( (ptr) )
+#else
+# define HT_PREFETCH(ptr)   (void)(ptr)
+#endif
 
 static struct {
     HT_Hash_Functions idx;
@@ -18,589 +56,2120 @@ static struct {
 } _hf[] = { { HF_HASH_JEN, hash_jen }, { HF_HASH_LY, hash_ly }, { HF_HASH_ROT13, hash_rot13 }, {
         HF_HASH_RS,
         hash_rs
-    }, { HF_HASH_CRC32, crc32 }
+    }, { HF_HASH_CRC32, crc32c }
 };
 
 /*
- * Create hash table with given initial size. Return created table or NULL.
+ * Internal, HTF_FLAT: control bytes group matching. Return bit mask of
+ * group bytes equal to 'c' (_ht_group_match) or having high bit set, i.e.
+ * empty or deleted slots (_ht_group_free). Group width and implementation
+ * are selected at runtime by _HT_Group_Init().
  */
-HTable HT_create( HT_Hash_Functions hf, size_t size, HT_Destructor destructor )
+typedef unsigned int ( *_HT_Group_Match )( const unsigned char *group,
+        unsigned char c );
+typedef unsigned int ( *_HT_Group_Free )( const unsigned char *group );
+
+static unsigned int _HT_Group_Match_Scalar( const unsigned char *group,
+        unsigned char c )
 {
-    size_t i;
-    const HTable ht = Malloc( sizeof( struct _HTable ) );
+    unsigned int i, mask = 0;
 
-    if( !ht ) {
-        return NULL;
+    for( i = 0; i < 16; i++ ) {
+        if( group[i] == c ) {
+            mask |= 1U << i;
+        }
     }
 
-    ht->size = size;
-
-    if( ht->size < HT_MIN_SIZE ) {
-        ht->size = HT_MIN_SIZE;
-    }
+    return mask;
+}
 
-    if( ht->size & ( ht->size - 1 ) ) {
-        /*
-         * Round up to the next highest power of 2:
-         */
-        i = 1;
+static unsigned int _HT_Group_Free_Scalar( const unsigned char *group )
+{
+    unsigned int i, mask = 0;
 
-        while( i < ht->size ) {
-            i *= 2;
+    for( i = 0; i < 16; i++ ) {
+        if( group[i] & 0x80 ) {
+            mask |= 1U << i;
         }
-
-        ht->size = i;
     }
 
-    ht->items = Calloc( ht->size, sizeof( HTItem ) );
+    return mask;
+}
 
-    if( !ht->items ) {
-        Free( ht );
-        return NULL;
-    }
+#if defined(HT_SIMD)
 
-    ht->nitems = 0;
-    ht->order = 0;
-    ht->hf = NULL;
-    ht->destructor = destructor;
-    ht->error = 0;
-    ht->flags = 0;
-    __initlock( ht->lock );
+static unsigned int _HT_Group_Match_SSE2( const unsigned char *group,
+        unsigned char c )
+{
+    __m128i g = _mm_loadu_si128( ( const __m128i * ) group );
+    return _mm_movemask_epi8( _mm_cmpeq_epi8( g, _mm_set1_epi8( ( char ) c ) ) );
+}
 
-    for( i = 0; i < sizeof( _hf ) / sizeof( _hf[0] ); i++ ) {
-        if( hf == _hf[i].idx ) {
-            ht->hf = _hf[i].hf;
-        }
-    }
+static unsigned int _HT_Group_Free_SSE2( const unsigned char *group )
+{
+    return _mm_movemask_epi8( _mm_loadu_si128( ( const __m128i * ) group ) );
+}
 
-    if( !ht->hf ) {
-        ht->hf = _hf[0].hf;
-    }
+__attribute__( ( target( "avx2" ) ) )
+static unsigned int _HT_Group_Match_AVX2( const unsigned char *group,
+        unsigned char c )
+{
+    __m256i g = _mm256_loadu_si256( ( const __m256i * ) group );
+    return ( unsigned int ) _mm256_movemask_epi8( _mm256_cmpeq_epi8( g,
+            _mm256_set1_epi8( ( char ) c ) ) );
+}
 
-    return ht;
+__attribute__( ( target( "avx2" ) ) )
+static unsigned int _HT_Group_Free_AVX2( const unsigned char *group )
+{
+    return ( unsigned int ) _mm256_movemask_epi8( _mm256_loadu_si256(
+                ( const __m256i * ) group ) );
 }
 
+#endif
+
+static _HT_Group_Match _ht_group_match = _HT_Group_Match_Scalar;
+static _HT_Group_Free _ht_group_free = _HT_Group_Free_Scalar;
+static size_t _ht_group_width = 16;
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+static pthread_once_t _ht_group_once = PTHREAD_ONCE_INIT;
+#else
+static int _ht_group_init = 0;
+#endif
+
 /*
- * Internal, destroy item:
+ * Internal, select best group matching functions for current CPU:
  */
-static void _HT_Destroy_Item( HTItem e, const HTable ht )
+static void _HT_Group_Select( void )
 {
-    if( e->next ) {
-        _HT_Destroy_Item( e->next, ht );
-    }
+#if defined(HT_SIMD)
+    __builtin_cpu_init();
 
-    if( ht->destructor ) {
-        ht->destructor( e->data );
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        _ht_group_match = _HT_Group_Match_AVX2;
+        _ht_group_free = _HT_Group_Free_AVX2;
+        _ht_group_width = 32;
+    }
+    else if( __builtin_cpu_supports( "sse2" ) ) {
+        _ht_group_match = _HT_Group_Match_SSE2;
+        _ht_group_free = _HT_Group_Free_SSE2;
     }
 
-    Free( e->key.key );
-    Free( e );
+#endif
 }
 
 /*
- * Delete all hash table items:
+ * Internal, select group functions once, before the first HTF_FLAT table is
+ * created. Threads which use the table later get it from this thread, so
+ * they see selected functions too.
  */
-void HT_clear( const HTable ht )
+static void _HT_Group_Init( void )
 {
-    size_t i;
-    __lock( ht->lock );
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+    pthread_once( &_ht_group_once, _HT_Group_Select );
+#else
 
-    for( i = 0; i < ht->size; i++ ) {
-        if( ht->items[i] ) {
-            _HT_Destroy_Item( ht->items[i], ht );
-        }
+    if( !_ht_group_init ) {
+        _HT_Group_Select();
+        _ht_group_init = 1;
     }
 
-    ht->nitems = 0;
-    ht->error = 0;
-    ht->order = 0;
-    __unlock( ht->lock );
+#endif
 }
 
 /*
- * Destroy hash table:
+ * Internal, lowest set bit index:
  */
-void HT_destroy( const HTable ht )
-{
-    HT_clear( ht );
-    Free( ht->items );
-    Free( ht );
-}
-
-static void _HT_ForEach( HTItem item, HT_Foreach foreach, void *data )
+static unsigned int _HT_Ctz( unsigned int mask )
 {
-    if( item->next ) {
-        _HT_ForEach( item->next, foreach, data );
+#if defined(__GNUC__)
+    return ( unsigned int ) __builtin_ctz( mask );
+#else
+    unsigned int i = 0;
+
+    while( !( mask & 1 ) ) {
+        mask >>= 1;
+        i++;
     }
 
-    foreach( item, data );
+    return i;
+#endif
 }
 
 /*
- * Foreach iterator:
+ * Internal, HTF_FLAT: set control byte. First HT_GROUP_MAX bytes are
+ * mirrored after the end of array, so group at any position can be loaded
+ * without wrapping.
  */
-void HT_foreach( const HTable ht, HT_Foreach foreach, void *data )
+static void _HT_Ctrl_Set( unsigned char *ctrl, size_t size, size_t i,
+                          unsigned char c )
 {
-    size_t i;
-    __lock( ht->lock );
+    ctrl[i] = c;
 
-    for( i = 0; i < ht->size; i++ ) {
-        if( ht->items[i] ) {
-            _HT_ForEach( ht->items[i], foreach, data );
-        }
+    if( i < HT_GROUP_MAX ) {
+        ctrl[size + i] = c;
     }
-
-    __unlock( ht->lock );
 }
 
-static void _HT_items( const HTItemConst item, void *data )
+/*
+ * Internal, HTF_FLAT: find first empty or deleted slot in probe sequence.
+ */
+static size_t _HT_Ctrl_Free_Slot( const unsigned char *ctrl, size_t mask,
+                                  unsigned int hash )
 {
-    struct {
-        HTItemConst *items;
-        size_t idx;
-        size_t nitems;
-    }*ptr = data;
+    size_t pos = hash & mask;
+    unsigned int free;
 
-    if( !ptr->items ) {
-        ptr->items = Malloc( sizeof( HTItem ) * ptr->nitems );
+    while( !( free = _ht_group_free( ctrl + pos ) ) ) {
+        pos = ( pos + _ht_group_width ) & mask;
     }
 
-    if( ptr->items ) {
-        ptr->items[ptr->idx++] = item;
-    }
+    return ( pos + _HT_Ctz( free ) ) & mask;
 }
 
 /*
- * Get hash table items (unordered):
+ * Internal, HTF_RCU: allocate buckets array (one memory block).
  */
-HTItemConst *HT_items( const HTable ht )
+static HTBuckets _HT_Buckets( size_t size )
 {
-    struct {
-        HTItemConst *items;
-        size_t idx;
-        size_t nitems;
-    } data = { NULL, 0, ht->nitems };
+    size_t bytes = sizeof( struct _HTBuckets ) + size * sizeof( HTItem );
+    HTBuckets buckets = Malloc_ptr( bytes );
 
-    if( ht->nitems ) {
-        HT_foreach( ht, _HT_items, &data );
+    if( buckets ) {
+        memset( buckets, 0, bytes );
+        buckets->size = size;
+        buckets->items = ( HTItem * )( buckets + 1 );
     }
 
-    return data.items;
+    return buckets;
 }
 
 /*
- * Internal, compare items insertion order:
+ * Internal, copy key to item. Return 1 (success) or 0 (no memory).
  */
-static int _HTItem_compare_order( const HTItemConst a, const HTItemConst b )
+static int _HT_Key_Set( const HTable ht, HTItem e, const void *key,
+                        size_t key_size )
 {
-    if( a->order != b->order ) {
-        return a->order > b->order ? 1 : -1;
+    if( key_size <= HT_INLINE_KEY ) {
+        e->key.key = e->ikey;
+    }
+    else if( !( e->key.key = ht->arena ? arena_alloc( ht->arena, key_size ) :
+                             Malloc( key_size ) ) ) {
+        return 0;
     }
 
-    return 0;
+    memcpy( e->key.key, key, key_size );
+    e->key.size = key_size;
+    return 1;
 }
 
 /*
- * Internal, insertion sort implementation:
+ * Internal, fix inline key pointer after item was copied to new place:
  */
-static HTItemConst *_HT_ISort( HTItemConst *items, size_t nitems,
-                               HT_Compare compare )
+static void _HT_Key_Move( HTItem e )
 {
-    size_t i, j;
-    HTItemConst tmp;
-
-    for( i = 1; i < nitems; i++ ) {
-        tmp = items[i];
-
-        for( j = i - 1; j >= 0; j-- ) {
-            if( compare( items[j], tmp ) < 0 ) {
-                break;
-            }
-
-            items[j + 1] = items[j];
-            items[j] = tmp;
-        }
+    if( e->key.size <= HT_INLINE_KEY ) {
+        e->key.key = e->ikey;
     }
+}
 
-    return items;
+static void _HT_Key_Free( const HTable ht, HTItem e )
+{
+    if( e->key.key != e->ikey && !ht->arena ) {
+        Free( e->key.key );
+    }
 }
 
 /*
- * Internal, quick sort implementation:
+ * Internal, chained items allocation (HTF_SLAB: from table slab, arena
+ * items are never freed). HTF_RCU 'next' is accessed atomically, so item
+ * must be pointer aligned (slab and arena memory is):
  */
-static HTItemConst *_HT_QSort( HTItemConst *items, size_t nitems,
-                               HT_Compare compare )
+static HTItem _HT_Item_Alloc( const HTable ht )
 {
-    long i, j;
-    long lb, ub;
-    long lbstack[QSORT_STACK_SIZE], ubstack[QSORT_STACK_SIZE];
-    size_t stackpos = 1, ppos;
-    HTItemConst pivot;
-    lbstack[1] = 0;
-    ubstack[1] = nitems - 1;
-
-    do {
-        lb = lbstack[stackpos];
-        ub = ubstack[stackpos];
-        stackpos--;
-
-        do {
-            ppos = ( lb + ub ) / 2;
-            i = lb;
-            j = ub;
-            pivot = items[ppos];
-
-            do {
-                while( compare( items[i], pivot ) < 0 ) {
-                    i++;
-                }
-
-                while( compare( pivot, items[j] ) < 0 ) {
-                    j--;
-                }
-
-                if( i <= j ) {
-                    if( i != j ) {
-                        HTItemConst tmp = items[i];
-                        items[i] = items[j];
-                        items[j] = tmp;
-                    }
-
-                    i++;
-                    j--;
-                }
-            } while( i <= j );
+    if( ht->arena ) {
+        return arena_alloc( ht->arena, sizeof( struct _HTItem ) );
+    }
 
-            if( i < ppos ) {
-                if( i < ub ) {
-                    stackpos++;
-                    lbstack[stackpos] = i;
-                    ubstack[stackpos] = ub;
-                }
+    if( ht->slab ) {
+        return slab_alloc( ht->slab );
+    }
 
-                ub = j;
-            }
-            else {
-                if( j > lb ) {
-                    stackpos++;
-                    lbstack[stackpos] = lb;
-                    ubstack[stackpos] = j;
-                }
+    return ht->flags & HTF_RCU ? Malloc_ptr( sizeof( struct _HTItem ) ) :
+           Malloc( sizeof( struct _HTItem ) );
+}
 
-                lb = i;
-            }
-        } while( lb < ub );
-    } while( stackpos != 0 );
+static void _HT_Item_Free( const HTable ht, HTItem e )
+{
+    if( ht->arena ) {
+        return;
+    }
 
-    return items;
+    if( ht->slab ) {
+        slab_free( ht->slab, e );
+    }
+    else {
+        Free( e );
+    }
 }
 
 /*
- * Internal, convert items array to keys array:
+ * Internal, insertion order list:
  */
-static HTIKeyConst *_HT_Items2Keys( HTItemConst *items, size_t max )
+static void _HT_Order_Append( const HTable ht, HTItem e )
 {
-    HTIKeyConst *keys = Malloc( max * sizeof( HTIKeyConst ) + 1 );
-
-    if( keys ) {
-        size_t i;
-
-        for( i = 0; i < max; i++ ) {
-            keys[i] = &items[i]->key;
-        }
+    e->onext = NULL;
+    e->oprev = ht->otail;
 
-        keys[i] = NULL;
+    if( ht->otail ) {
+        ht->otail->onext = e;
+    }
+    else {
+        ht->ohead = e;
     }
 
-    Free( items );
-    return keys;
+    ht->otail = e;
 }
 
-HTIKeyConst *HT_keys( const HTable ht )
+static void _HT_Order_Remove( const HTable ht, HTItem e )
 {
-    HTItemConst *items = HT_items( ht );
-
-    if( items ) {
-        return _HT_Items2Keys( items, ht->nitems );
+    if( e->oprev ) {
+        e->oprev->onext = e->onext;
+    }
+    else {
+        ht->ohead = e->onext;
     }
 
-    return NULL;
+    if( e->onext ) {
+        e->onext->oprev = e->oprev;
+    }
+    else {
+        ht->otail = e->oprev;
+    }
 }
 
 /*
- * Get keys sorted by insertion order:
+ * Internal, put item 'e' to the place of 'old':
  */
-HTIKeyConst *HT_ordered_keys( const HTable ht )
+static void _HT_Order_Replace( const HTable ht, HTItem old, HTItem e )
 {
-    HTItemConst *items = HT_ordered_items( ht );
+    e->oprev = old->oprev;
+    e->onext = old->onext;
 
-    if( items ) {
-        return _HT_Items2Keys( items, ht->nitems );
+    if( e->oprev ) {
+        e->oprev->onext = e;
+    }
+    else {
+        ht->ohead = e;
     }
 
-    return NULL;
+    if( e->onext ) {
+        e->onext->oprev = e;
+    }
+    else {
+        ht->otail = e;
+    }
 }
 
 /*
- * Get keys sorted by user function:
+ * Internal, HTF_RCU: ebr_retire() callback for deleted or replaced item.
  */
-HTIKeyConst *HT_sorted_keys( const HTable ht, HT_Compare compare )
+static void _HT_Retire_Item( void *ptr, void *arg )
 {
-    HTItemConst *items = HT_sorted_items( ht, compare );
+    HTItem e = ptr;
+    HTable ht = arg;
 
-    if( items ) {
-        return _HT_Items2Keys( items, ht->nitems );
+    if( ht->destructor ) {
+        ht->destructor( e->data );
     }
 
-    return NULL;
+    _HT_Key_Free( ht, e );
+    _HT_Item_Free( ht, e );
 }
 
 /*
- * Internal, convert items array to values array:
+ * Internal, HTF_RCU: ebr_retire() callback for buckets array left after
+ * resize. Items were copied to the new array, keys and data are shared.
  */
-static void const **_HT_Items2Values( HTItemConst *items, size_t max )
+static void _HT_Retire_Buckets( void *ptr, void *arg )
 {
-    void const **values = Malloc( max * sizeof( void const * ) + 1 );
+    HTBuckets buckets = ptr;
+    HTable ht = arg;
+    size_t i;
 
-    if( values ) {
-        size_t i;
+    for( i = 0; i < buckets->size; i++ ) {
+        HTItem e = buckets->items[i];
 
-        for( i = 0; i < max; i++ ) {
-            values[i] = items[i]->data;
+        while( e ) {
+            HTItem next = e->next;
+            _HT_Item_Free( ht, e );
+            e = next;
         }
-
-        values[i] = NULL;
     }
 
-    Free( items );
-    return values;
+    Free( buckets );
 }
 
-void const **HT_values( const HTable ht )
+/*
+ * Internal, get new random seed. Process seed is read from /dev/urandom
+ * (or made of time and addresses), tables seeds are derived from it and
+ * a counter.
+ */
+static unsigned long long _HT_Seed( void )
 {
-    HTItemConst *items = HT_items( ht );
+    static unsigned long long seed = 0;
+    static unsigned long long counter = 0;
+    unsigned long long base = __atomic_load_n( &seed, __ATOMIC_RELAXED );
+    unsigned long long n;
+
+    if( !base ) {
+#if defined(__unix__)
+        FILE *f = fopen( "/dev/urandom", "rb" );
+
+        if( f ) {
+            if( fread( &base, sizeof( base ), 1, f ) != 1 ) {
+                base = 0;
+            }
 
-    if( items ) {
-        return _HT_Items2Values( items, ht->nitems );
+            fclose( f );
+        }
+
+#endif
+        base ^= hash_wy_update( ( unsigned long long ) time( NULL ),
+                                &base, sizeof( base ) ) ^
+                ( unsigned long long )( size_t ) &base;
+        base |= 1;
+        __atomic_store_n( &seed, base, __ATOMIC_RELAXED );
     }
 
-    return NULL;
+    n = __atomic_add_fetch( &counter, 1, __ATOMIC_RELAXED );
+    return hash_wy_update( base, &n, sizeof( n ) );
+}
+
+int HT_set_seed( const HTable ht, unsigned long long seed )
+{
+    int rc = ENOTEMPTY;
+    __lock( ht->lock );
+
+    if( !ht->nitems ) {
+        ht->seed = seed;
+        rc = 0;
+    }
+
+    __unlock( ht->lock );
+    return rc;
 }
 
 /*
- * Get values sorted by insertion order:
+ * Create hash table with given initial size. Return created table or NULL.
  */
-void const **HT_ordered_values( const HTable ht )
+HTable HT_create( HT_Hash_Functions hf, size_t size, HT_Destructor destructor )
 {
-    HTItemConst *items = HT_ordered_items( ht );
+    return HT_create_ex( hf, size, destructor, 0 );
+}
 
-    if( items ) {
-        return _HT_Items2Values( items, ht->nitems );
+HTable HT_create_ex( HT_Hash_Functions hf, size_t size,
+                     HT_Destructor destructor, HT_Flags flags )
+{
+    size_t i;
+    HTable ht;
+
+    if( ( flags & HTF_FLAT ) && ( flags & HTF_RCU ) ) {
+        return NULL;
     }
 
-    return NULL;
+    /*
+     * HTF_RCU: ht->buckets is accessed atomically:
+     */
+    ht = Malloc_ptr( sizeof( struct _HTable ) );
+
+    if( !ht ) {
+        return NULL;
+    }
+
+    ht->size = size;
+
+    if( ht->size < HT_MIN_SIZE ) {
+        ht->size = HT_MIN_SIZE;
+    }
+
+    if( ht->size & ( ht->size - 1 ) ) {
+        /*
+         * Round up to the next highest power of 2:
+         */
+        i = 1;
+
+        while( i < ht->size ) {
+            i *= 2;
+        }
+
+        ht->size = i;
+    }
+
+    ht->items = NULL;
+    ht->slots = NULL;
+    ht->ctrl = NULL;
+    ht->buckets = NULL;
+    ht->slab = NULL;
+    ht->arena = NULL;
+    ht->ohead = ht->otail = NULL;
+
+    if( ( flags & HTF_SLAB ) && !( flags & HTF_FLAT ) ) {
+        ht->slab = slab_create( sizeof( struct _HTItem ), 0 );
+
+        if( !ht->slab ) {
+            Free( ht );
+            return NULL;
+        }
+    }
+
+    if( flags & HTF_RCU ) {
+        ht->buckets = _HT_Buckets( ht->size );
+
+        if( !ht->buckets ) {
+            if( ht->slab ) {
+                slab_destroy( ht->slab );
+            }
+
+            Free( ht );
+            return NULL;
+        }
+
+        ht->items = ht->buckets->items;
+    }
+    else if( flags & HTF_FLAT ) {
+        ht->slots = Malloc( ht->size * sizeof( struct _HTItem ) );
+        ht->ctrl = Malloc( ht->size + HT_GROUP_MAX );
+
+        if( !ht->slots || !ht->ctrl ) {
+            Free( ht->slots );
+            Free( ht->ctrl );
+            Free( ht );
+            return NULL;
+        }
+
+        memset( ht->ctrl, HT_CTRL_EMPTY, ht->size + HT_GROUP_MAX );
+        _HT_Group_Init();
+    }
+    else {
+        ht->items = Calloc( ht->size, sizeof( HTItem ) );
+
+        if( !ht->items ) {
+            if( ht->slab ) {
+                slab_destroy( ht->slab );
+            }
+
+            Free( ht );
+            return NULL;
+        }
+    }
+
+    ht->old_items = NULL;
+    ht->old_size = 0;
+    ht->rehash_idx = 0;
+    ht->rehash_step = ( flags & HTF_RCU ) ? 0 : HT_REHASH_STEP;
+    ht->grow = ( flags & HTF_FLAT ) ? HT_FLAT_GROW_LOAD : HT_GROW_LOAD;
+    ht->shrink = HT_SHRINK_LOAD;
+    ht->min_size = HT_MIN_SIZE;
+    ht->shrink_delay = 0;
+    ht->shrink_wait = 0;
+    ht->nexpand = 0;
+    ht->nreduce = 0;
+    ht->nitems = 0;
+    ht->ndeleted = 0;
+    ht->nmoves = 0;
+    ht->order = 0;
+    ht->hf = NULL;
+    ht->shf = NULL;
+    ht->seed = 0;
+    ht->destructor = destructor;
+    ht->error = 0;
+    ht->flags = flags;
+    __initlock( ht->lock );
+
+    for( i = 0; i < sizeof( _hf ) / sizeof( _hf[0] ); i++ ) {
+        if( hf == _hf[i].idx ) {
+            ht->hf = _hf[i].hf;
+        }
+    }
+
+    if( hf == HF_HASH_WY ) {
+        ht->shf = hash_wy_update;
+        ht->seed = _HT_Seed();
+    }
+    else if( !ht->hf ) {
+        ht->hf = _hf[0].hf;
+    }
+
+    return ht;
+}
+
+HTable HT_create_arena( HT_Hash_Functions hf, size_t size,
+                        HT_Destructor destructor, HT_Flags flags, Arena arena )
+{
+    HTable ht = HT_create_ex( hf, size, destructor, flags & ~HTF_SLAB );
+
+    if( ht ) {
+        ht->arena = arena;
+    }
+
+    return ht;
 }
 
 /*
- * Get values sorted by user function:
+ * Internal, destroy item:
  */
-void const **HT_sorted_values( const HTable ht, HT_Compare compare )
+static void _HT_Destroy_Item( HTItem e, const HTable ht )
 {
-    HTItemConst *items = HT_sorted_items( ht, compare );
+    if( e->next ) {
+        _HT_Destroy_Item( e->next, ht );
+    }
 
-    if( items ) {
-        return _HT_Items2Values( items, ht->nitems );
+    if( ht->destructor ) {
+        ht->destructor( e->data );
     }
 
-    return NULL;
+    _HT_Key_Free( ht, e );
+    _HT_Item_Free( ht, e );
 }
 
 /*
- * Get items sorted by insertion order:
+ * Delete all hash table items:
  */
-HTItemConst *HT_ordered_items( const HTable ht )
+void HT_clear( const HTable ht )
 {
-    return HT_sorted_items( ht, _HTItem_compare_order );
+    size_t i;
+    /*
+     * Arena items and keys are not freed, without destructor there is no
+     * reason to visit them:
+     */
+    int walk = !ht->arena || ht->destructor;
+    __lock( ht->lock );
+
+    if( ht->flags & HTF_RCU ) {
+        for( i = 0; i < ht->size; i++ ) {
+            HTItem e = ht->items[i];
+            __atomic_store_n( &ht->items[i], NULL, __ATOMIC_RELEASE );
+
+            while( e ) {
+                HTItem next = e->next;
+                ebr_retire( e, _HT_Retire_Item, ht );
+                e = next;
+            }
+        }
+    }
+    else if( ht->flags & HTF_FLAT ) {
+        for( i = 0; walk && i < ht->size; i++ ) {
+            if( HT_CTRL_FULL( ht->ctrl[i] ) ) {
+                if( ht->destructor ) {
+                    ht->destructor( ht->slots[i].data );
+                }
+
+                _HT_Key_Free( ht, &ht->slots[i] );
+            }
+        }
+
+        memset( ht->ctrl, HT_CTRL_EMPTY, ht->size + HT_GROUP_MAX );
+        ht->ndeleted = 0;
+    }
+    else {
+        for( i = 0; i < ht->size; i++ ) {
+            if( ht->items[i] ) {
+                if( walk ) {
+                    _HT_Destroy_Item( ht->items[i], ht );
+                }
+
+                ht->items[i] = NULL;
+            }
+        }
+
+        for( i = 0; walk && i < ht->old_size; i++ ) {
+            if( ht->old_items[i] ) {
+                _HT_Destroy_Item( ht->old_items[i], ht );
+            }
+        }
+
+        Free( ht->old_items );
+        ht->old_items = NULL;
+        ht->old_size = 0;
+        ht->rehash_idx = 0;
+    }
+
+    ht->nitems = 0;
+    ht->error = 0;
+    ht->order = 0;
+    ht->ohead = ht->otail = NULL;
+    __unlock( ht->lock );
 }
 
 /*
- * Sort items by user function:
+ * Destroy hash table:
  */
-HTItemConst *HT_sort_items( HTItemConst *items, size_t nitems,
-                            HT_Compare compare )
+void HT_destroy( const HTable ht )
 {
-    return nitems > ISORT_LIMIT ? _HT_QSort( items, nitems,
-            compare ) : _HT_ISort( items, nitems, compare );
+    HT_clear( ht );
+
+    if( ht->flags & HTF_RCU ) {
+        /*
+         * Wait for readers, destroy retired items:
+         */
+        ebr_synchronize();
+        Free( ht->buckets );
+    }
+    else {
+        Free( ht->items );
+    }
+
+    if( ht->slab ) {
+        slab_destroy( ht->slab );
+    }
+
+    Free( ht->slots );
+    Free( ht->ctrl );
+    Free( ht );
 }
 
 /*
- * Get items sorted by user function:
+ * HTF_RCU read-side critical section:
  */
-HTItemConst *HT_sorted_items( const HTable ht, HT_Compare compare )
+int HT_read_lock( const HTable ht )
 {
-    HTItemConst *items = HT_items( ht );
+    unused( ht );
+    return ebr_enter();
+}
 
-    if( items ) {
-        ht->nitems > ISORT_LIMIT ? _HT_QSort( items, ht->nitems,
-                                              compare ) : _HT_ISort( items, ht->nitems, compare );
+void HT_read_unlock( const HTable ht )
+{
+    unused( ht );
+    ebr_leave();
+}
+
+static void _HT_ForEach( HTItem item, HT_Foreach foreach, void *data )
+{
+    if( item->next ) {
+        _HT_ForEach( item->next, foreach, data );
     }
 
-    return items;
+    foreach( item, data );
 }
 
 /*
- * Returm max items bucket length:
+ * Foreach iterator:
  */
-size_t HT_max_bucket( const HTable ht )
+void HT_foreach( const HTable ht, HT_Foreach foreach, void *data )
 {
     size_t i;
-    size_t max_bucket;
     __lock( ht->lock );
-    ht->error = 0;
-    max_bucket = 0;
-
-    for( i = 0; i < ht->size; i++ ) {
-        if( ht->items[i] && ht->items[i]->next ) {
-            size_t bucket = 0;
-            HTItem e = ht->items[i];
 
-            while( e ) {
-                bucket++;
-                e = e->next;
+    if( ht->flags & HTF_FLAT ) {
+        for( i = 0; i < ht->size; i++ ) {
+            if( HT_CTRL_FULL( ht->ctrl[i] ) ) {
+                foreach( &ht->slots[i], data );
             }
+        }
+    }
+    else {
+        for( i = 0; i < ht->size; i++ ) {
+            if( ht->items[i] ) {
+                _HT_ForEach( ht->items[i], foreach, data );
+            }
+        }
 
-            if( bucket > max_bucket ) {
-                max_bucket = bucket;
+        for( i = 0; i < ht->old_size; i++ ) {
+            if( ht->old_items[i] ) {
+                _HT_ForEach( ht->old_items[i], foreach, data );
             }
         }
     }
 
     __unlock( ht->lock );
-    return max_bucket;
 }
 
-HTable HT_disable_expand( const HTable ht )
+void HT_iter_init( HTIter *iter )
 {
-    ht->flags |= HTF_DISABLE_EXPAND;
-    return ht;
+    iter->cursor = 0;
+    iter->nmoves = 0;
+    iter->done = 0;
+}
+
+/*
+ * Internal, reverse bits of cursor:
+ */
+static size_t _HT_Rev( size_t v )
+{
+    size_t s = 8 * sizeof( v );
+    size_t mask = ~( size_t ) 0;
+
+    while( ( s >>= 1 ) > 0 ) {
+        mask ^= ( mask << s );
+        v = ( ( v >> s ) & mask ) | ( ( v << s ) & ~mask );
+    }
+
+    return v;
+}
+
+/*
+ * Internal, increment high bits of cursor not covered by mask:
+ */
+static size_t _HT_Cursor_Next( size_t v, size_t mask )
+{
+    v |= ~mask;
+    v = _HT_Rev( v );
+    v++;
+    return _HT_Rev( v );
+}
+
+static void _HT_Iter_Bucket( HTItem e, HT_Foreach foreach, void *data )
+{
+    while( e ) {
+        HTItem next = e->next;
+        foreach( e, data );
+        e = next;
+    }
+}
+
+/*
+ * Incremental scan step:
+ */
+int HT_iter_next( const HTable ht, HTIter *iter, size_t count,
+                  HT_Foreach foreach, void *data )
+{
+    size_t v = iter->cursor;
+
+    if( iter->done ) {
+        return 0;
+    }
+
+    __lock( ht->lock );
+
+    if( ht->flags & HTF_FLAT ) {
+        if( iter->nmoves != ht->nmoves ) {
+            iter->nmoves = ht->nmoves;
+            v = 0;
+        }
+
+        while( count-- && v < ht->size ) {
+            if( HT_CTRL_FULL( ht->ctrl[v] ) ) {
+                foreach( &ht->slots[v], data );
+            }
+
+            v++;
+        }
+
+        iter->done = v >= ht->size;
+    }
+    else {
+        while( count-- ) {
+            if( !ht->old_items ) {
+                size_t m0 = HT_HASH_MASK( ht );
+                _HT_Iter_Bucket( ht->items[v & m0], foreach, data );
+                v = _HT_Cursor_Next( v, m0 );
+            }
+            else {
+                /*
+                 * Incremental resize: visit bucket of the smaller array and
+                 * all buckets of the larger one it is expanded to:
+                 */
+                HTItem *t0 = ht->items, *t1 = ht->old_items;
+                size_t m0 = HT_HASH_MASK( ht ), m1 = ht->old_size - 1;
+
+                if( ht->old_size < ht->size ) {
+                    t0 = ht->old_items;
+                    t1 = ht->items;
+                    m0 = ht->old_size - 1;
+                    m1 = HT_HASH_MASK( ht );
+                }
+
+                _HT_Iter_Bucket( t0[v & m0], foreach, data );
+
+                do {
+                    _HT_Iter_Bucket( t1[v & m1], foreach, data );
+                    v = _HT_Cursor_Next( v, m1 );
+                }
+                while( v & ( m0 ^ m1 ) );
+            }
+
+            if( !v ) {
+                iter->done = 1;
+                break;
+            }
+        }
+    }
+
+    iter->cursor = v;
+    __unlock( ht->lock );
+    return !iter->done;
 }
 
-HTable HT_disable_reduce( const HTable ht )
-{
-    ht->flags |= HTF_DISABLE_REDUCE;
-    return ht;
-}
+static void _HT_items( const HTItemConst item, void *data )
+{
+    struct {
+        HTItemConst *items;
+        size_t idx;
+        size_t nitems;
+    }*ptr = data;
+
+    if( !ptr->items ) {
+        ptr->items = Malloc( sizeof( HTItem ) * ptr->nitems );
+    }
+
+    if( ptr->items ) {
+        ptr->items[ptr->idx++] = item;
+    }
+}
+
+/*
+ * Get hash table items (unordered):
+ */
+HTItemConst *HT_items( const HTable ht )
+{
+    struct {
+        HTItemConst *items;
+        size_t idx;
+        size_t nitems;
+    } data = { NULL, 0, ht->nitems };
+
+    if( ht->nitems ) {
+        HT_foreach( ht, _HT_items, &data );
+    }
+
+    return data.items;
+}
+
+/*
+ * Ordered cursor:
+ */
+HTItemConst HT_ordered_first( const HTable ht )
+{
+    HTItemConst e;
+    __lock( ht->lock );
+    e = ht->ohead;
+    __unlock( ht->lock );
+    return e;
+}
+
+HTItemConst HT_ordered_last( const HTable ht )
+{
+    HTItemConst e;
+    __lock( ht->lock );
+    e = ht->otail;
+    __unlock( ht->lock );
+    return e;
+}
+
+HTItemConst HT_ordered_next( const HTable ht, HTItemConst item )
+{
+    HTItemConst e;
+    unused( ht );
+    __lock( ht->lock );
+    e = item->onext;
+    __unlock( ht->lock );
+    return e;
+}
+
+HTItemConst HT_ordered_prev( const HTable ht, HTItemConst item )
+{
+    HTItemConst e;
+    unused( ht );
+    __lock( ht->lock );
+    e = item->oprev;
+    __unlock( ht->lock );
+    return e;
+}
+
+/*
+ * Foreach iterator, insertion order:
+ */
+void HT_ordered_foreach( const HTable ht, HT_Foreach foreach, void *data )
+{
+    HTItem e;
+    __lock( ht->lock );
+
+    for( e = ht->ohead; e; e = e->onext ) {
+        foreach( e, data );
+    }
+
+    __unlock( ht->lock );
+}
+
+/*
+ * Internal, insertion sort implementation:
+ */
+static HTItemConst *_HT_ISort( HTItemConst *items, size_t nitems,
+                               HT_Compare compare )
+{
+    size_t i, j;
+    HTItemConst tmp;
+
+    for( i = 1; i < nitems; i++ ) {
+        tmp = items[i];
+
+        for( j = i; j > 0 && compare( items[j - 1], tmp ) > 0; j-- ) {
+            items[j] = items[j - 1];
+        }
+
+        items[j] = tmp;
+    }
+
+    return items;
+}
+
+/*
+ * Internal, quick sort implementation:
+ */
+static HTItemConst *_HT_QSort( HTItemConst *items, size_t nitems,
+                               HT_Compare compare )
+{
+    long i, j;
+    long lb, ub;
+    long lbstack[QSORT_STACK_SIZE], ubstack[QSORT_STACK_SIZE];
+    size_t stackpos = 1;
+    long ppos;
+    HTItemConst pivot;
+    lbstack[1] = 0;
+    ubstack[1] = nitems - 1;
+
+    do {
+        lb = lbstack[stackpos];
+        ub = ubstack[stackpos];
+        stackpos--;
+
+        do {
+            ppos = ( lb + ub ) / 2;
+            i = lb;
+            j = ub;
+            pivot = items[ppos];
+
+            do {
+                while( compare( items[i], pivot ) < 0 ) {
+                    i++;
+                }
+
+                while( compare( pivot, items[j] ) < 0 ) {
+                    j--;
+                }
+
+                if( i <= j ) {
+                    if( i != j ) {
+                        HTItemConst tmp = items[i];
+                        items[i] = items[j];
+                        items[j] = tmp;
+                    }
+
+                    i++;
+                    j--;
+                }
+            } while( i <= j );
+
+            /*
+             * Larger part is deferred, so stack depth is at most
+             * log2(nitems):
+             */
+            if( j - lb < ub - i ) {
+                if( i < ub ) {
+                    stackpos++;
+                    lbstack[stackpos] = i;
+                    ubstack[stackpos] = ub;
+                }
+
+                ub = j;
+            }
+            else {
+                if( j > lb ) {
+                    stackpos++;
+                    lbstack[stackpos] = lb;
+                    ubstack[stackpos] = j;
+                }
+
+                lb = i;
+            }
+        } while( lb < ub );
+    } while( stackpos != 0 );
+
+    return items;
+}
+
+static HTItemConst *_HT_Sort( HTItemConst *items, size_t nitems,
+                              HT_Compare compare )
+{
+    return nitems > ISORT_LIMIT ? _HT_QSort( items, nitems,
+            compare ) : _HT_ISort( items, nitems, compare );
+}
+
+#if defined(HT_PSORT)
+
+/*
+ * Internal, parallel merge sort: halves are sorted in new thread and in
+ * current one, then merged. 'depth' is log2 of threads count.
+ */
+typedef struct _HT_PSort_Job {
+    HTItemConst *items;
+    HTItemConst *tmp;
+    size_t nitems;
+    HT_Compare compare;
+    unsigned int depth;
+} HT_PSort_Job;
+
+static void *_HT_PSort( void *arg )
+{
+    HT_PSort_Job *job = arg;
+    HT_PSort_Job left = *job, right = *job;
+    size_t half = job->nitems / 2;
+    size_t i = 0, j = half, k = 0;
+    pthread_t thread;
+    int threaded;
+
+    if( !job->depth || job->nitems < PSORT_LIMIT ) {
+        _HT_Sort( job->items, job->nitems, job->compare );
+        return NULL;
+    }
+
+    left.nitems = half;
+    left.depth--;
+    right.items += half;
+    right.tmp += half;
+    right.nitems -= half;
+    right.depth--;
+    threaded = !pthread_create( &thread, NULL, _HT_PSort, &left );
+
+    if( !threaded ) {
+        _HT_PSort( &left );
+    }
+
+    _HT_PSort( &right );
+
+    if( threaded ) {
+        pthread_join( thread, NULL );
+    }
+
+    while( i < half && j < job->nitems ) {
+        job->tmp[k++] = job->compare( job->items[j], job->items[i] ) < 0 ?
+                        job->items[j++] : job->items[i++];
+    }
+
+    while( i < half ) {
+        job->tmp[k++] = job->items[i++];
+    }
+
+    while( j < job->nitems ) {
+        job->tmp[k++] = job->items[j++];
+    }
+
+    memcpy( job->items, job->tmp, job->nitems * sizeof( HTItemConst ) );
+    return NULL;
+}
+
+/*
+ * Internal, log2 of sort threads count:
+ */
+static unsigned int _HT_PSort_Depth( size_t nitems )
+{
+    long ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+    unsigned int depth = 0;
+
+    while( ( 2L << depth ) <= ncpu && ( 2U << depth ) <= PSORT_MAX_THREADS &&
+            nitems >> ( depth + 1 ) >= PSORT_LIMIT / 2 ) {
+        depth++;
+    }
+
+    return depth;
+}
+
+#endif
+
+/*
+ * Internal, sort items array, in parallel if it is large. Falls back to
+ * single thread sort if there is no memory for merge buffer.
+ */
+static HTItemConst *_HT_Sort_Items( HTItemConst *items, size_t nitems,
+                                    HT_Compare compare )
+{
+#if defined(HT_PSORT)
+
+    if( nitems >= PSORT_LIMIT ) {
+        HT_PSort_Job job;
+        job.depth = _HT_PSort_Depth( nitems );
+        job.tmp = job.depth ? Malloc( nitems * sizeof( HTItemConst ) ) : NULL;
+
+        if( job.tmp ) {
+            job.items = items;
+            job.nitems = nitems;
+            job.compare = compare;
+            _HT_PSort( &job );
+            Free( job.tmp );
+            return items;
+        }
+    }
+
+#endif
+    return _HT_Sort( items, nitems, compare );
+}
+
+/*
+ * Internal, convert items array to keys array:
+ */
+static HTIKeyConst *_HT_Items2Keys( HTItemConst *items, size_t max )
+{
+    HTIKeyConst *keys = Malloc( ( max + 1 ) * sizeof( HTIKeyConst ) );
+
+    if( keys ) {
+        size_t i;
+
+        for( i = 0; i < max; i++ ) {
+            keys[i] = &items[i]->key;
+        }
+
+        keys[i] = NULL;
+    }
+
+    Free( items );
+    return keys;
+}
+
+HTIKeyConst *HT_keys( const HTable ht )
+{
+    HTItemConst *items = HT_items( ht );
+
+    if( items ) {
+        return _HT_Items2Keys( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Get keys sorted by insertion order:
+ */
+HTIKeyConst *HT_ordered_keys( const HTable ht )
+{
+    HTItemConst *items = HT_ordered_items( ht );
+
+    if( items ) {
+        return _HT_Items2Keys( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Get keys sorted by user function:
+ */
+HTIKeyConst *HT_sorted_keys( const HTable ht, HT_Compare compare )
+{
+    HTItemConst *items = HT_sorted_items( ht, compare );
+
+    if( items ) {
+        return _HT_Items2Keys( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Internal, convert items array to values array:
+ */
+static void const **_HT_Items2Values( HTItemConst *items, size_t max )
+{
+    void const **values = Malloc( ( max + 1 ) * sizeof( void const * ) );
+
+    if( values ) {
+        size_t i;
+
+        for( i = 0; i < max; i++ ) {
+            values[i] = items[i]->data;
+        }
+
+        values[i] = NULL;
+    }
+
+    Free( items );
+    return values;
+}
+
+void const **HT_values( const HTable ht )
+{
+    HTItemConst *items = HT_items( ht );
+
+    if( items ) {
+        return _HT_Items2Values( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Get values sorted by insertion order:
+ */
+void const **HT_ordered_values( const HTable ht )
+{
+    HTItemConst *items = HT_ordered_items( ht );
+
+    if( items ) {
+        return _HT_Items2Values( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Get values sorted by user function:
+ */
+void const **HT_sorted_values( const HTable ht, HT_Compare compare )
+{
+    HTItemConst *items = HT_sorted_items( ht, compare );
+
+    if( items ) {
+        return _HT_Items2Values( items, ht->nitems );
+    }
+
+    return NULL;
+}
+
+/*
+ * Get items sorted by insertion order:
+ */
+HTItemConst *HT_ordered_items( const HTable ht )
+{
+    HTItemConst *items = NULL;
+    HTItem e;
+    size_t i = 0;
+    __lock( ht->lock );
+
+    if( ht->nitems ) {
+        items = Malloc( ht->nitems * sizeof( HTItemConst ) );
+
+        if( items ) {
+            for( e = ht->ohead; e; e = e->onext ) {
+                items[i++] = e;
+            }
+        }
+    }
+
+    __unlock( ht->lock );
+    return items;
+}
+
+/*
+ * Sort items by user function:
+ */
+HTItemConst *HT_sort_items( HTItemConst *items, size_t nitems,
+                            HT_Compare compare )
+{
+    return _HT_Sort_Items( items, nitems, compare );
+}
+
+/*
+ * Get items sorted by user function:
+ */
+HTItemConst *HT_sorted_items( const HTable ht, HT_Compare compare )
+{
+    HTItemConst *items = HT_items( ht );
+
+    if( items ) {
+        _HT_Sort_Items( items, ht->nitems, compare );
+    }
+
+    return items;
+}
+
+/*
+ * Internal, HT_top_items() heap: 'k' best items with the worst one at the
+ * root.
+ */
+static void _HT_Heap_Down( HTItemConst *heap, size_t n, size_t i,
+                           HT_Compare compare )
+{
+    HTItemConst e = heap[i];
+
+    for( ;; ) {
+        size_t child = 2 * i + 1;
+
+        if( child >= n ) {
+            break;
+        }
+
+        if( child + 1 < n && compare( heap[child + 1], heap[child] ) > 0 ) {
+            child++;
+        }
+
+        if( compare( heap[child], e ) <= 0 ) {
+            break;
+        }
+
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = e;
+}
+
+/*
+ * Get first 'k' items in sorting order:
+ */
+HTItemConst *HT_top_items( const HTable ht, HT_Compare compare, size_t k )
+{
+    HTItemConst *heap;
+    HTItem e;
+    size_t n = 0;
+    __lock( ht->lock );
+
+    if( k > ht->nitems ) {
+        k = ht->nitems;
+    }
+
+    heap = Malloc( ( k + 1 ) * sizeof( HTItemConst ) );
+
+    if( !heap ) {
+        __unlock( ht->lock );
+        return NULL;
+    }
+
+    for( e = ht->ohead; e && k; e = e->onext ) {
+        if( n < k ) {
+            size_t i = n++;
+
+            /*
+             * Sift up:
+             */
+            while( i && compare( heap[( i - 1 ) / 2], e ) < 0 ) {
+                heap[i] = heap[( i - 1 ) / 2];
+                i = ( i - 1 ) / 2;
+            }
+
+            heap[i] = e;
+        }
+        else if( compare( e, heap[0] ) < 0 ) {
+            heap[0] = e;
+            _HT_Heap_Down( heap, n, 0, compare );
+        }
+    }
+
+    __unlock( ht->lock );
+
+    /*
+     * Heap sort, the worst item goes to the end:
+     */
+    while( n > 1 ) {
+        HTItemConst tmp = heap[0];
+        heap[0] = heap[--n];
+        heap[n] = tmp;
+        _HT_Heap_Down( heap, n, 0, compare );
+    }
+
+    heap[k] = NULL;
+    return heap;
+}
+
+/*
+ * Returm max items bucket length:
+ */
+size_t HT_max_bucket( const HTable ht )
+{
+    size_t i;
+    size_t max_bucket;
+    __lock( ht->lock );
+    ht->error = 0;
+    max_bucket = 0;
+
+    if( ht->flags & HTF_FLAT ) {
+        for( i = 0; i < ht->size; i++ ) {
+            if( HT_CTRL_FULL( ht->ctrl[i] ) ) {
+                size_t bucket = ( ( i - ht->slots[i].hash ) & HT_HASH_MASK( ht ) ) + 1;
+
+                if( bucket > max_bucket ) {
+                    max_bucket = bucket;
+                }
+            }
+        }
+
+        __unlock( ht->lock );
+        return max_bucket;
+    }
+
+    for( i = 0; i < ht->size + ht->old_size; i++ ) {
+        HTItem e = i < ht->size ? ht->items[i] : ht->old_items[i - ht->size];
+
+        if( e && e->next ) {
+            size_t bucket = 0;
+
+            while( e ) {
+                bucket++;
+                e = e->next;
+            }
+
+            if( bucket > max_bucket ) {
+                max_bucket = bucket;
+            }
+        }
+    }
+
+    __unlock( ht->lock );
+    return max_bucket;
+}
+
+HTable HT_disable_expand( const HTable ht )
+{
+    ht->flags |= HTF_DISABLE_EXPAND;
+    return ht;
+}
+
+HTable HT_disable_reduce( const HTable ht )
+{
+    ht->flags |= HTF_DISABLE_REDUCE;
+    return ht;
+}
+
+HTable HT_enable_expand( const HTable ht )
+{
+    ht->flags &= ( ~HTF_DISABLE_EXPAND );
+    return ht;
+}
+
+HTable HT_enable_reduce( const HTable ht )
+{
+    ht->flags &= ( ~HTF_DISABLE_REDUCE );
+    return ht;
+}
+
+/*
+ * Reduce storage. Return 1 (success) or 0 (failed). Do not change internal
+ * error code.
+ */
+static int _HT_Reduce( const HTable ht )
+{
+    size_t newsize;
+    HTItem *items;
+    size_t i;
+
+    if( ht->size < HT_MIN_SIZE ) {
+        return 1;
+    }
+
+    newsize = ht->size / 2;
+    items = Calloc( newsize, sizeof( HTItem ) );
+
+    if( !items ) {
+        return 0;
+    }
+
+    memcpy( items, ht->items, newsize * sizeof( HTItem ) );
+
+    for( i = newsize; i < ht->size; i++ ) {
+        HTItem cur;
+
+        if( !ht->items[i] ) {
+            continue;
+        }
+
+        if( !items[i - newsize] ) {
+            items[i - newsize] = ht->items[i];
+        }
+        else {
+            cur = items[i - newsize];
+
+            while( cur->next ) {
+                cur = cur->next;
+            }
+
+            cur->next = ht->items[i];
+        }
+    }
+
+    Free( ht->items );
+    ht->items = items;
+    ht->size = newsize;
+    return 1;
+}
+
+/*
+ * Expand storage. Return 1 (success) or 0 (failed). Do not change internal
+ * error code.
+ */
+static int _HT_Expand( const HTable ht )
+{
+    size_t newsize = ht->size * 2;
+    size_t newmask;
+    size_t mask;
+    size_t i;
+    HTItem *items = Calloc( newsize, sizeof( HTItem ) );
+
+    if( !items ) {
+        return 0;
+    }
+
+    mask = HT_HASH_MASK( ht );
+    newmask = newsize - 1;
+    memcpy( items, ht->items, ht->size * sizeof( HTItem ) );
+
+    for( i = 0; i < ht->size; i++ ) {
+        HTItem cur = items[i], prev = NULL, temp;
+
+        while( cur ) {
+            if( ( cur->hash & mask ) != ( cur->hash & newmask ) ) {
+                if( !prev ) {
+                    items[i] = cur->next;
+                }
+                else {
+                    prev->next = cur->next;
+                }
+
+                temp = cur->next;
+                cur->next = items[cur->hash & newmask];
+                items[cur->hash & newmask] = cur;
+                cur = temp;
+            }
+            else {
+                prev = cur;
+                cur = cur->next;
+            }
+        }
+    }
+
+    Free( ht->items );
+    ht->items = items;
+    ht->size = newsize;
+    return 1;
+}
+
+/*
+ * Internal, move up to 'n' not empty buckets from the old buckets array to
+ * the current one (incremental resize). Do nothing if resize is not in
+ * progress.
+ */
+static void _HT_Rehash_Step( const HTable ht, size_t n )
+{
+    size_t mask = HT_HASH_MASK( ht );
+    size_t visits = n * 10;
+
+    while( ht->old_items && n && visits ) {
+        HTItem e = ht->old_items[ht->rehash_idx];
+
+        if( e ) {
+            ht->old_items[ht->rehash_idx] = NULL;
+
+            while( e ) {
+                HTItem next = e->next;
+                size_t idx = e->hash & mask;
+                e->next = ht->items[idx];
+                ht->items[idx] = e;
+                e = next;
+            }
+
+            n--;
+        }
+
+        visits--;
+
+        if( ++ht->rehash_idx == ht->old_size ) {
+            Free( ht->old_items );
+            ht->old_items = NULL;
+            ht->old_size = 0;
+            ht->rehash_idx = 0;
+        }
+    }
+}
+
+/*
+ * Internal, HTF_RCU: resize storage. Readers can walk old chains at the
+ * moment, so items are not relinked: new array is filled with copies of
+ * items and published at once, old array and items are retired. Return 1
+ * (success) or 0 (failed). Do not change internal error code.
+ */
+static int _HT_Rcu_Resize( const HTable ht, size_t newsize )
+{
+    size_t mask = newsize - 1;
+    HTBuckets old = ht->buckets;
+    HTBuckets buckets = _HT_Buckets( newsize );
+    HTItem e;
+    HTItem head = NULL;
+    HTItem tail = NULL;
+
+    if( !buckets ) {
+        return 0;
+    }
+
+    /*
+     * Copies are made in insertion order, order list is rebuilt at once:
+     */
+    for( e = ht->ohead; e; e = e->onext ) {
+        HTItem copy = _HT_Item_Alloc( ht );
+
+        if( !copy ) {
+            _HT_Retire_Buckets( buckets, ht );
+            return 0;
+        }
+
+        *copy = *e;
+        _HT_Key_Move( copy );
+        copy->next = buckets->items[e->hash & mask];
+        buckets->items[e->hash & mask] = copy;
+        copy->oprev = tail;
+        copy->onext = NULL;
+
+        if( tail ) {
+            tail->onext = copy;
+        }
+        else {
+            head = copy;
+        }
+
+        tail = copy;
+    }
+
+    ht->ohead = head;
+    ht->otail = tail;
+
+    if( newsize > ht->size ) {
+        ht->nexpand++;
+    }
+    else {
+        ht->nreduce++;
+    }
+
+    __atomic_store_n( &ht->buckets, buckets, __ATOMIC_RELEASE );
+    ht->items = buckets->items;
+    ht->size = newsize;
+    ebr_retire( old, _HT_Retire_Buckets, ht );
+    return 1;
+}
+
+/*
+ * Internal, resize storage. Large tables are resized incrementally: new
+ * buckets array become current one and items are moved from the old one
+ * by _HT_Rehash_Step() on every HT_set(), HT_get() and HT_del() call.
+ * Return 1 (success) or 0 (failed). Do not change internal error code.
+ */
+static int _HT_Resize( const HTable ht, size_t newsize )
+{
+    HTItem *items;
+    int expand = newsize > ht->size;
+
+    if( ht->flags & HTF_RCU ) {
+        return _HT_Rcu_Resize( ht, newsize );
+    }
+
+    while( ht->old_items ) {
+        _HT_Rehash_Step( ht, ht->old_size );
+    }
+
+    if( !ht->rehash_step || ( ht->size < HT_INCREMENTAL_MIN &&
+                              newsize < HT_INCREMENTAL_MIN ) ) {
+        if( !( expand ? _HT_Expand( ht ) : _HT_Reduce( ht ) ) ) {
+            return 0;
+        }
+    }
+    else {
+        items = Calloc( newsize, sizeof( HTItem ) );
+
+        if( !items ) {
+            return 0;
+        }
+
+        ht->old_items = ht->items;
+        ht->old_size = ht->size;
+        ht->rehash_idx = 0;
+        ht->items = items;
+        ht->size = newsize;
+        _HT_Rehash_Step( ht, ht->rehash_step );
+    }
+
+    /*
+     * Count performed resizes only:
+     */
+    if( expand ) {
+        ht->nexpand++;
+    }
+    else {
+        ht->nreduce++;
+    }
+
+    return 1;
+}
+
+/*
+ * Internal, find item in chained buckets (both arrays while resize is in
+ * progress). Return pointer to the link which points to the item or NULL.
+ */
+static HTItem *_HT_Link( const HTable ht, unsigned int hash, const void *key,
+                         size_t key_size )
+{
+    HTItem *link;
+
+    if( ht->old_items ) {
+        link = &ht->old_items[hash & ( ht->old_size - 1 )];
+
+        while( *link ) {
+            if( ( *link )->key.size == key_size &&
+                    !memcmp( ( *link )->key.key, key, key_size ) ) {
+                return link;
+            }
+
+            link = &( *link )->next;
+        }
+    }
+
+    link = &ht->items[hash & HT_HASH_MASK( ht )];
+
+    while( *link ) {
+        if( ( *link )->key.size == key_size &&
+                !memcmp( ( *link )->key.key, key, key_size ) ) {
+            return link;
+        }
+
+        link = &( *link )->next;
+    }
+
+    return NULL;
+}
+
+/*
+ * Set resize policy:
+ */
+HTable HT_set_policy( const HTable ht, unsigned int grow, unsigned int shrink,
+                      size_t min_size, size_t shrink_delay )
+{
+    __lock( ht->lock );
+
+    if( !grow ) {
+        grow = ( ht->flags & HTF_FLAT ) ? HT_FLAT_GROW_LOAD : HT_GROW_LOAD;
+    }
+
+    ht->grow = grow;
+    ht->shrink = shrink;
+    ht->min_size = min_size < HT_MIN_SIZE ? HT_MIN_SIZE : min_size;
+    ht->shrink_delay = shrink_delay;
+    ht->shrink_wait = 0;
+    __unlock( ht->lock );
+    return ht;
+}
+
+/*
+ * Internal, check if table must be expanded after insert:
+ */
+static int _HT_Need_Expand( const HTable ht )
+{
+    ht->shrink_wait = 0;
+    return !( ht->flags & HTF_DISABLE_EXPAND ) &&
+           ht->nitems * 100 > ht->size * ht->grow;
+}
+
+/*
+ * Internal, check if table must be reduced after delete. Load must stay
+ * below ht->shrink for more than ht->shrink_delay calls in a row.
+ */
+static int _HT_Need_Reduce( const HTable ht )
+{
+    if( ( ht->flags & HTF_DISABLE_REDUCE ) || ht->size / 2 < ht->min_size ||
+            ht->nitems * 100 >= ht->size * ht->shrink ) {
+        ht->shrink_wait = 0;
+        return 0;
+    }
+
+    if( ht->shrink_wait++ < ht->shrink_delay ) {
+        return 0;
+    }
+
+    ht->shrink_wait = 0;
+    return 1;
+}
+
+/*
+ * Internal, HTF_FLAT: max number of used (or deleted) slots before rehash.
+ */
+static size_t _HT_Flat_Limit( const HTable ht )
+{
+    size_t limit = HT_FLAT_MAX_LOAD( ht->size );
+
+    if( !( ht->flags & HTF_DISABLE_EXPAND ) &&
+            ht->size * ht->grow / 100 < limit ) {
+        limit = ht->size * ht->grow / 100;
+    }
+
+    return limit;
+}
+
+/*
+ * Set incremental resize step:
+ */
+HTable HT_rehash_step( const HTable ht, size_t step )
+{
+    __lock( ht->lock );
+    ht->rehash_step = step;
+
+    while( !step && ht->old_items ) {
+        _HT_Rehash_Step( ht, ht->old_size );
+    }
+
+    __unlock( ht->lock );
+    return ht;
+}
+
+/*
+ * Internal, HTF_FLAT: move all items to new slots array. Used to expand,
+ * reduce and to drop deleted slots. Return 1 (success) or 0 (failed). Do
+ * not change internal error code.
+ */
+static int _HT_Flat_Rehash( const HTable ht, size_t newsize )
+{
+    size_t j;
+    HTItem e;
+    size_t newmask = newsize - 1;
+    struct _HTItem *slots = Malloc( newsize * sizeof( struct _HTItem ) );
+    unsigned char *ctrl = Malloc( newsize + HT_GROUP_MAX );
+
+    if( !slots || !ctrl ) {
+        Free( slots );
+        Free( ctrl );
+        return 0;
+    }
+
+    memset( ctrl, HT_CTRL_EMPTY, newsize + HT_GROUP_MAX );
+
+    if( newsize > ht->size ) {
+        ht->nexpand++;
+    }
+    else if( newsize < ht->size ) {
+        ht->nreduce++;
+    }
+
+    /*
+     * Items are moved in insertion order, so the order list is rebuilt by
+     * appending:
+     */
+    e = ht->ohead;
+    ht->ohead = ht->otail = NULL;
+
+    for( ; e; e = e->onext ) {
+        j = _HT_Ctrl_Free_Slot( ctrl, newmask, e->hash );
+        _HT_Ctrl_Set( ctrl, newsize, j, HT_CTRL_TAG( e->hash ) );
+        slots[j] = *e;
+        _HT_Key_Move( &slots[j] );
+        _HT_Order_Append( ht, &slots[j] );
+    }
+
+    Free( ht->slots );
+    Free( ht->ctrl );
+    ht->slots = slots;
+    ht->ctrl = ctrl;
+    ht->size = newsize;
+    ht->ndeleted = 0;
+    ht->nmoves++;
+    return 1;
+}
+
+/*
+ * Internal, HTF_FLAT: find item slot. Return slot index or HT_NO_SLOT.
+ * Whole group of control bytes is compared with hash tag at once, keys are
+ * compared only for matched slots.
+ */
+static size_t _HT_Flat_Find( const HTable ht, unsigned int hash,
+                             const void *key, size_t key_size )
+{
+    size_t mask = HT_HASH_MASK( ht );
+    size_t pos = hash & mask;
+    unsigned char tag = HT_CTRL_TAG( hash );
+
+    forever() {
+        unsigned int match = _ht_group_match( ht->ctrl + pos, tag );
+        unsigned int empty = _ht_group_match( ht->ctrl + pos, HT_CTRL_EMPTY );
+
+        if( empty ) {
+            /*
+             * Probe sequence ends at the first empty slot:
+             */
+            match &= ( empty & ( ~empty + 1 ) ) - 1;
+        }
+
+        while( match ) {
+            size_t i = ( pos + _HT_Ctz( match ) ) & mask;
+            HTItem e = &ht->slots[i];
+
+            if( e->hash == hash && e->key.size == key_size &&
+                    !memcmp( e->key.key, key, key_size ) ) {
+                return i;
+            }
+
+            match &= match - 1;
+        }
+
+        if( empty ) {
+            return HT_NO_SLOT;
+        }
+
+        pos = ( pos + _ht_group_width ) & mask;
+    }
+}
+
+/*
+ * Internal, HTF_FLAT: insert or replace item.
+ */
+static HTItemConst _HT_Flat_Set( const HTable ht, unsigned int hash,
+                                 const void *key, size_t key_size, void *data )
+{
+    size_t slot = _HT_Flat_Find( ht, hash, key, key_size );
+    HTItem e;
+
+    if( slot != HT_NO_SLOT ) {
+        e = &ht->slots[slot];
+
+        if( ht->destructor ) {
+            ht->destructor( e->data );
+        }
+
+        e->data = data;
+        ht->error = 0;
+        return e;
+    }
+
+    slot = _HT_Ctrl_Free_Slot( ht->ctrl, HT_HASH_MASK( ht ), hash );
+    ht->shrink_wait = 0;
+
+    if( ht->ctrl[slot] == HT_CTRL_EMPTY &&
+            ht->nitems + ht->ndeleted + 1 > _HT_Flat_Limit( ht ) ) {
+        /*
+         * Expand if the table is half full, just drop deleted slots
+         * otherwise:
+         */
+        size_t newsize = ht->size;
+
+        if( ht->nitems + 1 > _HT_Flat_Limit( ht ) ||
+                ( ht->nitems >= ht->size / 2 &&
+                  !( ht->flags & HTF_DISABLE_EXPAND ) ) ) {
+            newsize *= 2;
+        }
+
+        if( !_HT_Flat_Rehash( ht, newsize ) ) {
+            ht->error = ENOMEM;
+            return NULL;
+        }
+
+        slot = _HT_Ctrl_Free_Slot( ht->ctrl, HT_HASH_MASK( ht ), hash );
+    }
+
+    e = &ht->slots[slot];
+
+    if( !_HT_Key_Set( ht, e, key, key_size ) ) {
+        ht->error = ENOMEM;
+        return NULL;
+    }
 
-HTable HT_enable_expand( const HTable ht )
-{
-    ht->flags &= ( ~HTF_DISABLE_EXPAND );
-    return ht;
-}
+    e->order = ht->order++;
+    e->data = data;
+    e->hash = hash;
+    e->next = NULL;
+    _HT_Order_Append( ht, e );
 
-HTable HT_enable_reduce( const HTable ht )
-{
-    ht->flags &= ( ~HTF_DISABLE_REDUCE );
-    return ht;
+    if( ht->ctrl[slot] == HT_CTRL_DELETED ) {
+        ht->ndeleted--;
+    }
+
+    _HT_Ctrl_Set( ht->ctrl, ht->size, slot, HT_CTRL_TAG( hash ) );
+    ht->error = 0;
+    ht->nitems++;
+    return e;
 }
 
 /*
- * Reduce storage. Return 1 (success) or 0 (failed). Do not change internal
- * error code.
+ * Internal, HTF_FLAT: delete item.
  */
-static int _HT_Reduce( const HTable ht )
+static int _HT_Flat_Del( const HTable ht, unsigned int hash, const void *key,
+                         size_t key_size )
 {
-    size_t newsize;
-    HTItem *items;
-    size_t i;
+    size_t i = _HT_Flat_Find( ht, hash, key, key_size );
 
-    if( ht->size < HT_MIN_SIZE ) {
-        return 1;
+    if( i == HT_NO_SLOT ) {
+        ht->error = ENOKEY;
+        return ht->error;
     }
 
-    newsize = ht->size / 2;
-    items = Calloc( newsize, sizeof( HTItem ) );
-
-    if( !items ) {
-        return 0;
+    if( ht->destructor ) {
+        ht->destructor( ht->slots[i].data );
     }
 
-    memcpy( items, ht->items, newsize * sizeof( HTItem ) );
+    _HT_Order_Remove( ht, &ht->slots[i] );
+    _HT_Key_Free( ht, &ht->slots[i] );
 
-    for( i = newsize; i < ht->size; i++ ) {
-        HTItem cur;
+    /*
+     * Probe sequence will stop at the next empty slot anyway:
+     */
+    if( ht->ctrl[( i + 1 ) & HT_HASH_MASK( ht )] == HT_CTRL_EMPTY ) {
+        _HT_Ctrl_Set( ht->ctrl, ht->size, i, HT_CTRL_EMPTY );
+    }
+    else {
+        _HT_Ctrl_Set( ht->ctrl, ht->size, i, HT_CTRL_DELETED );
+        ht->ndeleted++;
+    }
 
-        if( !ht->items[i] ) {
-            continue;
-        }
+    ht->nitems--;
+    ht->error = 0;
 
-        if( !items[i - newsize] ) {
-            items[i - newsize] = ht->items[i];
-        }
-        else {
-            cur = items[i - newsize];
+    if( !ht->nitems ) {
+        ht->order = 0;
+    }
 
-            while( cur->next ) {
-                cur = cur->next;
-            }
+    if( _HT_Need_Reduce( ht ) ) {
+        _HT_Flat_Rehash( ht, ht->size / 2 );
+    }
 
-            cur->next = ht->items[i];
-        }
+    return ht->error;
+}
+
+/*
+ * Get key hash value used by table:
+ */
+unsigned int HT_hash( const HTable ht, const void *key, size_t key_size )
+{
+    if( ht->shf ) {
+        unsigned long long hash = ht->shf( ht->seed, key, key_size );
+        return ( unsigned int )( hash ^ ( hash >> 32 ) );
     }
 
-    Free( ht->items );
-    ht->items = items;
-    ht->size = newsize;
-    return 1;
+    return ht->hf( key, key_size );
 }
 
 /*
- * Expand storage. Return 1 (success) or 0 (failed). Do not change internal
- * error code.
+ * Internal, find item. Set internal error code.
  */
-static int _HT_Expand( const HTable ht )
+static HTItem _HT_Get( const HTable ht, unsigned int hash, const void *key,
+                       size_t key_size )
 {
-    size_t newsize = ht->size * 2;
-    size_t newmask;
-    size_t mask;
-    size_t i;
-    HTItem *items = Calloc( newsize, sizeof( HTItem ) );
+    HTItem *link;
+    HTItem e;
 
-    if( !items ) {
-        return 0;
+    if( ht->flags & HTF_FLAT ) {
+        size_t i = _HT_Flat_Find( ht, hash, key, key_size );
+        ht->error = i == HT_NO_SLOT ? ENOKEY : 0;
+        return i == HT_NO_SLOT ? NULL : &ht->slots[i];
     }
 
-    mask = HT_HASH_MASK( ht );
-    newmask = newsize - 1;
-    memcpy( items, ht->items, ht->size * sizeof( HTItem ) );
-
-    for( i = 0; i < ht->size; i++ ) {
-        HTItem cur = items[i], prev = NULL, temp;
+    _HT_Rehash_Step( ht, ht->rehash_step );
+    link = _HT_Link( ht, hash, key, key_size );
+    e = link ? *link : NULL;
+    ht->error = e ? 0 : ENOKEY;
+    return e;
+}
 
-        while( cur ) {
-            if( ( cur->hash & mask ) != ( cur->hash & newmask ) ) {
-                if( !prev ) {
-                    items[i] = cur->next;
-                }
-                else {
-                    prev->next = cur->next;
-                }
+/*
+ * Internal, HTF_RCU: find item without lock. Must be called inside
+ * read-side critical section.
+ */
+static HTItem _HT_Rcu_Get( const HTable ht, unsigned int hash,
+                           const void *key, size_t key_size )
+{
+    HTBuckets buckets = __atomic_load_n( &ht->buckets, __ATOMIC_ACQUIRE );
+    HTItem e = __atomic_load_n( &buckets->items[hash & ( buckets->size - 1 )],
+                                __ATOMIC_ACQUIRE );
 
-                temp = cur->next;
-                cur->next = items[cur->hash & newmask];
-                items[cur->hash & newmask] = cur;
-                cur = temp;
-            }
-            else {
-                prev = cur;
-                cur = cur->next;
-            }
+    while( e ) {
+        if( e->hash == hash && e->key.size == key_size &&
+                !memcmp( e->key.key, key, key_size ) ) {
+            break;
         }
+
+        e = __atomic_load_n( &e->next, __ATOMIC_ACQUIRE );
     }
 
-    Free( ht->items );
-    ht->items = items;
-    ht->size = newsize;
-    return 1;
+    return e;
 }
 
 /*
@@ -609,30 +2178,57 @@ static int _HT_Expand( const HTable ht )
  */
 HTItemConst HT_get( const HTable ht, const void *key, size_t key_size )
 {
-    unsigned int hash;
+    return HT_get_h( ht, HT_hash( ht, key, key_size ), key, key_size );
+}
+
+HTItemConst HT_get_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size )
+{
     HTItem e;
-    __lock( ht->lock );
-    hash = ht->hf( key, key_size );
-    e = ht->items[hash & HT_HASH_MASK( ht )];
-    ht->error = ENOKEY;
 
-    while( e ) {
-        if( e->key.size == key_size && !memcmp( e->key.key, key, key_size ) ) {
-            ht->error = 0;
-            break;
+    if( ht->flags & HTF_RCU ) {
+        if( !ebr_enter() ) {
+            return NULL;
         }
 
-        e = e->next;
+        e = _HT_Rcu_Get( ht, hash, key, key_size );
+        ebr_leave();
+        return e;
     }
 
+    __lock( ht->lock );
+    e = _HT_Get( ht, hash, key, key_size );
     __unlock( ht->lock );
     return e;
 }
 
 void const *HT_val( const HTable ht, const void *key, size_t key_size )
 {
-    HTItemConst item = HT_get( ht, key, key_size );
-    return item ? item->data : NULL;
+    return HT_val_h( ht, HT_hash( ht, key, key_size ), key, key_size );
+}
+
+void const *HT_val_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size )
+{
+    HTItem e;
+    void const *data;
+
+    if( ht->flags & HTF_RCU ) {
+        if( !ebr_enter() ) {
+            return NULL;
+        }
+
+        e = _HT_Rcu_Get( ht, hash, key, key_size );
+        data = e ? e->data : NULL;
+        ebr_leave();
+        return data;
+    }
+
+    __lock( ht->lock );
+    e = _HT_Get( ht, hash, key, key_size );
+    data = e ? e->data : NULL;
+    __unlock( ht->lock );
+    return data;
 }
 
 /*
@@ -641,53 +2237,61 @@ void const *HT_val( const HTable ht, const void *key, size_t key_size )
  */
 int HT_del( const HTable ht, const void *key, size_t key_size )
 {
-    unsigned int hash;
-    HTItem cursor;
+    return HT_del_h( ht, HT_hash( ht, key, key_size ), key, key_size );
+}
+
+int HT_del_h( const HTable ht, unsigned int hash, const void *key,
+              size_t key_size )
+{
+    HTItem *link;
     HTItem e;
-    size_t idx;
+    int rc;
     __lock( ht->lock );
-    e = NULL;
-    hash = ht->hf( key, key_size );
-    idx = hash & HT_HASH_MASK( ht );
-    cursor = ht->items[idx];
-    ht->error = ENOKEY;
-
-    while( cursor ) {
-        if( cursor->key.size == key_size &&
-                !memcmp( cursor->key.key, key, key_size ) ) {
-            if( !e ) {
-                ht->items[idx] = cursor->next;
-            }
-            else {
-                e->next = cursor->next;
-            }
 
-            if( ht->destructor ) {
-                ht->destructor( cursor->data );
-            }
+    if( ht->flags & HTF_FLAT ) {
+        rc = _HT_Flat_Del( ht, hash, key, key_size );
+        __unlock( ht->lock );
+        return rc;
+    }
 
-            Free( cursor->key.key );
-            Free( cursor );
-            ht->nitems--;
-            ht->error = 0;
+    _HT_Rehash_Step( ht, ht->rehash_step );
+    link = _HT_Link( ht, hash, key, key_size );
 
-            if( !ht->items ) {
-                ht->order = 0;
-            }
+    if( !link ) {
+        ht->error = ENOKEY;
+        __unlock( ht->lock );
+        return ENOKEY;
+    }
 
-            if( ( ht->nitems < ht->size / 2 ) && !( ht->flags & HTF_DISABLE_REDUCE ) ) {
-                _HT_Reduce( ht );
-            }
+    e = *link;
+    __atomic_store_n( link, e->next, __ATOMIC_RELEASE );
+    _HT_Order_Remove( ht, e );
 
-            break;
+    if( ht->flags & HTF_RCU ) {
+        ebr_retire( e, _HT_Retire_Item, ht );
+    }
+    else {
+        if( ht->destructor ) {
+            ht->destructor( e->data );
         }
 
-        e = cursor;
-        cursor = cursor->next;
+        _HT_Key_Free( ht, e );
+        _HT_Item_Free( ht, e );
+    }
+
+    ht->nitems--;
+    ht->error = 0;
+
+    if( !ht->nitems ) {
+        ht->order = 0;
+    }
+
+    if( _HT_Need_Reduce( ht ) ) {
+        _HT_Resize( ht, ht->size / 2 );
     }
 
     __unlock( ht->lock );
-    return ht->error;
+    return 0;
 }
 
 /*
@@ -697,66 +2301,234 @@ int HT_del( const HTable ht, const void *key, size_t key_size )
 HTItemConst HT_set( const HTable ht, const void *key, size_t key_size,
                     void *data )
 {
-    unsigned int hash;
+    return HT_set_h( ht, HT_hash( ht, key, key_size ), key, key_size, data );
+}
+
+/*
+ * Internal, insert or replace item. Set internal error code.
+ */
+static HTItemConst _HT_Set( const HTable ht, unsigned int hash,
+                            const void *key, size_t key_size, void *data )
+{
+    HTItem *link;
     HTItem e;
     HTItem item;
     size_t idx;
-    __lock( ht->lock );
-    hash = ht->hf( key, key_size );
-    idx = hash & HT_HASH_MASK( ht );
-    e = ht->items[idx];
 
-    while( e ) {
-        if( e->key.size == key_size && !memcmp( e->key.key, key, key_size ) ) {
-            if( ht->destructor ) {
-                ht->destructor( e->data );
-            }
+    if( ht->flags & HTF_FLAT ) {
+        return _HT_Flat_Set( ht, hash, key, key_size, data );
+    }
+
+    _HT_Rehash_Step( ht, ht->rehash_step );
+    link = _HT_Link( ht, hash, key, key_size );
 
-            e->data = data;
-            ht->error = 0;
-            __unlock( ht->lock );
-            return e;
+    if( link && !( ht->flags & HTF_RCU ) ) {
+        e = *link;
+
+        if( ht->destructor ) {
+            ht->destructor( e->data );
         }
 
-        e = e->next;
+        e->data = data;
+        ht->error = 0;
+        return e;
     }
 
-    item = Malloc( sizeof( struct _HTItem ) );
+    item = _HT_Item_Alloc( ht );
 
     if( !item ) {
         ht->error = ENOMEM;
-        __unlock( ht->lock );
         return NULL;
     }
 
-    item->key.key = Malloc( key_size );
-
-    if( !item->key.key ) {
+    if( !_HT_Key_Set( ht, item, key, key_size ) ) {
         ht->error = ENOMEM;
-        Free( item );
-        __unlock( ht->lock );
+        _HT_Item_Free( ht, item );
         return NULL;
     }
 
-    memcpy( item->key.key, key, key_size );
-    item->key.size = key_size;
-    item->order = ht->order++;
     item->data = data;
-    item->next = NULL;
     item->hash = hash;
-    item->next = ht->items[idx];
-    ht->items[idx] = item;
     ht->error = 0;
+
+    if( link ) {
+        /*
+         * HTF_RCU: readers can see old item, replace it with new one:
+         */
+        e = *link;
+        item->order = e->order;
+        item->next = e->next;
+        _HT_Order_Replace( ht, e, item );
+        __atomic_store_n( link, item, __ATOMIC_RELEASE );
+        ebr_retire( e, _HT_Retire_Item, ht );
+        return item;
+    }
+
+    item->order = ht->order++;
+    _HT_Order_Append( ht, item );
+    idx = hash & HT_HASH_MASK( ht );
+    item->next = ht->items[idx];
+    __atomic_store_n( &ht->items[idx], item, __ATOMIC_RELEASE );
     ht->nitems++;
 
-    if( ( ht->nitems > ht->size ) && !( ht->flags & HTF_DISABLE_EXPAND ) ) {
-        _HT_Expand( ht );
+    if( _HT_Need_Expand( ht ) ) {
+        _HT_Resize( ht, ht->size * 2 );
     }
 
-    __unlock( ht->lock );
     return item;
 }
 
+HTItemConst HT_set_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size, void *data )
+{
+    HTItemConst e;
+    __lock( ht->lock );
+    e = _HT_Set( ht, hash, key, key_size, data );
+    __unlock( ht->lock );
+    return e;
+}
+
+/*
+ * Internal, prefetch buckets (slots and control bytes for HTF_FLAT tables)
+ * of hashes chunk. Chain heads are read after all buckets were requested,
+ * so cache misses overlap instead of being paid one by one.
+ */
+static void _HT_Prefetch( const HTable ht, HTItem *items, size_t size,
+                          const unsigned int *hashes, size_t n )
+{
+    size_t i;
+    size_t mask = size - 1;
+
+    if( ht->flags & HTF_FLAT ) {
+        for( i = 0; i < n; i++ ) {
+            HT_PREFETCH( ht->ctrl + ( hashes[i] & mask ) );
+            HT_PREFETCH( &ht->slots[hashes[i] & mask] );
+        }
+
+        return;
+    }
+
+    for( i = 0; i < n; i++ ) {
+        HT_PREFETCH( &items[hashes[i] & mask] );
+    }
+
+    for( i = 0; i < n; i++ ) {
+        HTItem e = __atomic_load_n( &items[hashes[i] & mask],
+                                    __ATOMIC_RELAXED );
+
+        if( e ) {
+            HT_PREFETCH( e );
+        }
+    }
+}
+
+/*
+ * Batch lookup. Set internal error code (ENOKEY if any key was not found).
+ */
+size_t HT_get_many( const HTable ht, const void *const *keys,
+                    const size_t *sizes, size_t n, HTItemConst *items )
+{
+    unsigned int hashes[HT_BATCH];
+    size_t i, j, chunk;
+    size_t found = 0;
+
+    for( i = 0; i < n; i += chunk ) {
+        chunk = n - i < HT_BATCH ? n - i : HT_BATCH;
+
+        for( j = 0; j < chunk; j++ ) {
+            hashes[j] = HT_hash( ht, keys[i + j], sizes[i + j] );
+        }
+
+        if( ht->flags & HTF_RCU ) {
+            HTBuckets buckets;
+
+            if( !ebr_enter() ) {
+                for( j = 0; j < chunk; j++ ) {
+                    items[i + j] = NULL;
+                }
+
+                continue;
+            }
+
+            buckets = __atomic_load_n( &ht->buckets, __ATOMIC_ACQUIRE );
+            _HT_Prefetch( ht, buckets->items, buckets->size, hashes, chunk );
+
+            for( j = 0; j < chunk; j++ ) {
+                items[i + j] = _HT_Rcu_Get( ht, hashes[j], keys[i + j],
+                                            sizes[i + j] );
+                found += items[i + j] != NULL;
+            }
+
+            ebr_leave();
+            continue;
+        }
+
+        __lock( ht->lock );
+        _HT_Prefetch( ht, ht->items, ht->size, hashes, chunk );
+
+        for( j = 0; j < chunk; j++ ) {
+            items[i + j] = _HT_Get( ht, hashes[j], keys[i + j], sizes[i + j] );
+            found += items[i + j] != NULL;
+        }
+
+        if( i + chunk == n ) {
+            ht->error = found == n ? 0 : ENOKEY;
+        }
+
+        __unlock( ht->lock );
+    }
+
+    if( !n && !( ht->flags & HTF_RCU ) ) {
+        __lock( ht->lock );
+        ht->error = 0;
+        __unlock( ht->lock );
+    }
+
+    return found;
+}
+
+/*
+ * Batch insert. Set internal error code (ENOMEM if any item was not
+ * stored).
+ */
+size_t HT_set_many( const HTable ht, const void *const *keys,
+                    const size_t *sizes, void *const *data, size_t n )
+{
+    unsigned int hashes[HT_BATCH];
+    size_t i, j, chunk;
+    size_t stored = 0;
+
+    for( i = 0; i < n; i += chunk ) {
+        chunk = n - i < HT_BATCH ? n - i : HT_BATCH;
+
+        for( j = 0; j < chunk; j++ ) {
+            hashes[j] = HT_hash( ht, keys[i + j], sizes[i + j] );
+        }
+
+        __lock( ht->lock );
+        _HT_Prefetch( ht, ht->items, ht->size, hashes, chunk );
+
+        for( j = 0; j < chunk; j++ ) {
+            stored += _HT_Set( ht, hashes[j], keys[i + j], sizes[i + j],
+                               data[i + j] ) != NULL;
+        }
+
+        if( i + chunk == n ) {
+            ht->error = stored == n ? 0 : ENOMEM;
+        }
+
+        __unlock( ht->lock );
+    }
+
+    if( !n ) {
+        __lock( ht->lock );
+        ht->error = 0;
+        __unlock( ht->lock );
+    }
+
+    return stored;
+}
+
 /*
  * Various key types:
  */
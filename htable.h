@@ -12,9 +12,24 @@ extern "C" {
 
 #include "config.h"
 #include "_lock.h"
+#include "ebr.h"
+#include "slab.h"
+#include "arena.h"
 #include <errno.h>
 
 #define HT_MIN_SIZE     64
+/*
+ * Tables with HT_INCREMENTAL_MIN or more buckets are resized incrementally,
+ * up to HT_REHASH_STEP buckets are moved per call (see HT_rehash_step()):
+ */
+#define HT_INCREMENTAL_MIN  (1024*64)
+#define HT_REHASH_STEP      16
+/*
+ * Default resize policy, load factors in percents (see HT_set_policy()):
+ */
+#define HT_GROW_LOAD        100
+#define HT_FLAT_GROW_LOAD   87
+#define HT_SHRINK_LOAD      25
 
 typedef struct _HTIKey {
     void *key;
@@ -23,42 +38,105 @@ typedef struct _HTIKey {
 
 typedef struct _HTIKey const *HTIKeyConst;
 
+/*
+ * Keys up to HT_INLINE_KEY bytes are stored in the item itself ('key.key'
+ * points to 'ikey'), longer ones are allocated separately:
+ */
+#define HT_INLINE_KEY       16
+
 typedef struct _HTItem {
     struct _HTIKey key;
     size_t order;
     void *data;
     unsigned int hash;
     struct _HTItem *next;
+    /*
+     * Insertion order list:
+     */
+    struct _HTItem *oprev;
+    struct _HTItem *onext;
+    char ikey[HT_INLINE_KEY];
 } *HTItem;
 
 typedef struct _HTItem const *HTItemConst;
 
+/*
+ * HF_HASH_CRC32 is crc32c() (see crc.h): one SSE4.2 / ARMv8 instruction per
+ * 8 bytes where available.
+ * HF_HASH_WY: 64-bit word-at-a-time hash (see hash.h), every table gets
+ * random seed, so hash values can not be predicted by whoever supplies the
+ * keys (hash flooding).
+ */
 typedef enum {
     HF_HASH_JEN, HF_HASH_LY, HF_HASH_ROT13, HF_HASH_RS,
-    HF_HASH_CRC32
+    HF_HASH_CRC32, HF_HASH_WY
 } HT_Hash_Functions;
 
 typedef unsigned int ( *HT_Hash_Function )( const void *data, size_t size );
+typedef unsigned long long( *HT_Seed_Hash_Function )( unsigned long long seed,
+        const void *data, size_t size );
 typedef void ( *HT_Destructor )( void *data );
 
 typedef enum _HT_Flags {
     HTF_DISABLE_EXPAND = 0x01,
-    HTF_DISABLE_REDUCE = 0x02
+    HTF_DISABLE_REDUCE = 0x02,
+    HTF_FLAT = 0x04,            /* open addressing storage, see HT_create_ex() */
+    HTF_RCU = 0x08,             /* lock-free readers, see HT_create_ex() */
+    HTF_SLAB = 0x10             /* items from table slab, see HT_create_ex() */
 } HT_Flags;
 
+/*
+ * HTF_RCU: buckets array published to lock-free readers:
+ */
+typedef struct _HTBuckets {
+    size_t size;
+    HTItem *items;
+} *HTBuckets;
+
 typedef struct _HTable {
     size_t size;
     size_t nitems;
     HTItem *items;
+    struct _HTItem *slots;
+    unsigned char *ctrl;
+    size_t ndeleted;
+    size_t nmoves;              /* HTF_FLAT: storage rehash counter */
+    HTBuckets buckets;
+    HTItem *old_items;
+    size_t old_size;
+    size_t rehash_idx;
+    size_t rehash_step;
+    unsigned int grow;
+    unsigned int shrink;
+    size_t min_size;
+    size_t shrink_delay;
+    size_t shrink_wait;
+    size_t nexpand;
+    size_t nreduce;
     HT_Destructor destructor;
     HT_Hash_Function hf;
+    HT_Seed_Hash_Function shf;
+    unsigned long long seed;
     HT_Flags flags;
+    Slab slab;                  /* HTF_SLAB: items allocator */
+    Arena arena;                /* see HT_create_arena() */
     size_t order;
+    HTItem ohead;
+    HTItem otail;
     int error;
     __lock_t( lock );
 } *HTable;
 
 typedef void ( *HT_Foreach )( const HTItemConst item, void *data );
+
+/*
+ * Resumable iterator, see HT_iter_next():
+ */
+typedef struct _HTIter {
+    size_t cursor;
+    size_t nmoves;
+    int done;
+} HTIter;
 typedef int ( *HT_Compare )( const HTItemConst a, const HTItemConst b );
 
 /*
@@ -68,15 +146,90 @@ typedef int ( *HT_Compare )( const HTItemConst a, const HTItemConst b );
  * 'destructor' is a function to delete elements data. Can be NULL.
  */
 HTable HT_create( HT_Hash_Functions hf, size_t size, HT_Destructor destructor );
+/*
+ * Same as HT_create(), 'flags' are HT_Flags. With HTF_FLAT items are kept in
+ * one contiguous array (open addressing, linear probing) instead of chained
+ * buckets: no per-item allocation and no pointer chasing on lookup. Each
+ * slot has a control byte with 7-bit hash tag, lookup compares 16 (SSE2) or
+ * 32 (AVX2) tags at once, the code is selected at runtime (scalar fallback
+ * on other CPUs), keys are compared only for matched tags.
+ * WARNING: in HTF_FLAT mode HTItemConst pointers returned by HT_set() and
+ * HT_get() are valid only until the next HT_set() or HT_del() call (storage
+ * can be rehashed). The table is always expanded when it is full, even if
+ * HTF_DISABLE_EXPAND is set.
+ *
+ * With HTF_RCU HT_get() and HT_val() take no lock: readers never wait for
+ * writers (writers still lock the table against each other). Items deleted
+ * or replaced by HT_set()/HT_del() (and their data) are destroyed only when
+ * no reader can see them (see ebr.h), so HTItemConst and data pointers stay
+ * valid until HT_read_unlock():
+ *
+ *      HT_read_lock( ht );
+ *      item = HT_get( ht, key, key_size );
+ *      ... use item ...
+ *      HT_read_unlock( ht );
+ *
+ * HT_set() on existing key replaces whole item, expand and reduce copy all
+ * items. HT_get() does not set HTable.error. Can not be combined with
+ * HTF_FLAT. Real concurrency requires USE_LOCKING.
+ *
+ * With HTF_SLAB chained items are allocated from the table own slab (see
+ * slab.h): no allocator header per item, items are packed in large chunks.
+ * Slab memory is released by HT_destroy() only. Ignored for HTF_FLAT.
+ */
+HTable HT_create_ex( HT_Hash_Functions hf, size_t size,
+                     HT_Destructor destructor, HT_Flags flags );
+/*
+ * Same as HT_create_ex(), items and long keys are allocated from 'arena'
+ * (see arena.h) and released by arena_reset() / arena_destroy() only,
+ * HTF_SLAB is ignored. HT_del(), HT_clear() and HT_destroy() do not free
+ * them; if 'destructor' is NULL they are not visited at all. Table
+ * itself and buckets are allocated as usual. With HTF_RCU arena must not be
+ * reset before HT_destroy().
+ */
+HTable HT_create_arena( HT_Hash_Functions hf, size_t size,
+                        HT_Destructor destructor, HT_Flags flags, Arena arena );
 void HT_clear( const HTable ht );
 void HT_destroy( const HTable ht );
 
+/*
+ * HTF_RCU read-side critical section (can be nested). HT_read_lock() return
+ * 1 (success) or 0 (no memory for thread record):
+ */
+int HT_read_lock( const HTable ht );
+void HT_read_unlock( const HTable ht );
+
 /*
  * Foreach iterator:
  */
 void HT_foreach( const HTable ht, HT_Foreach foreach, void *data );
 /*
- * Get max collision-bucket length:
+ * Incremental scan, no memory allocation. Every HT_iter_next() call visits
+ * up to 'count' buckets (slots for HTF_FLAT tables) and calls 'foreach'
+ * for their items under table lock, which is released between calls, so
+ * the table can be changed while scan is suspended. Return 1 if there are
+ * more buckets to visit or 0 when scan is complete:
+ *
+ *      HTIter iter;
+ *      HT_iter_init( &iter );
+ *      while( HT_iter_next( ht, &iter, 100, foreach, data ) ) {
+ *          ... do something else ...
+ *      }
+ *
+ * Chained tables use reverse binary cursor (see Redis SCAN): items which
+ * are in the table during the whole scan are visited at least once even
+ * if the table is resized between calls, such items can be visited twice
+ * only if the table was reduced. Items added or deleted during the scan
+ * can be visited or not. HTF_FLAT tables: scan is restarted when items
+ * were moved by rehash since the previous call, so items can be visited
+ * several times (and scan never completes if the table is rehashed all
+ * the time). 'foreach' must not change the table.
+ */
+void HT_iter_init( HTIter *iter );
+int HT_iter_next( const HTable ht, HTIter *iter, size_t count,
+                  HT_Foreach foreach, void *data );
+/*
+ * Get max collision-bucket length (max probe length for HTF_FLAT tables):
  * TODO remove this?
  */
 size_t HT_max_bucket( const HTable ht );
@@ -88,6 +241,46 @@ HTable HT_disable_expand( const HTable ht );
 HTable HT_disable_reduce( const HTable ht );
 HTable HT_enable_expand( const HTable ht );
 HTable HT_enable_reduce( const HTable ht );
+/*
+ * Set resize policy. 'grow' and 'shrink' are load factors in percents
+ * (items per 100 buckets or slots): the table is expanded when load goes
+ * above 'grow' and reduced when load stays below 'shrink' for more than
+ * 'shrink_delay' HT_del() calls in a row. The table is never reduced below
+ * 'min_size' buckets. 'grow' 0 means default for the storage type, HTF_FLAT
+ * tables are always expanded at 7/8 load. Keep 'shrink' well below half of
+ * 'grow', otherwise the table can be expanded and reduced on alternating
+ * calls. HTable.nexpand and HTable.nreduce count resizes.
+ * Return HTable pointer from arguments.
+ */
+HTable HT_set_policy( const HTable ht, unsigned int grow, unsigned int shrink,
+                      size_t min_size, size_t shrink_delay );
+/*
+ * Set hash seed (HF_HASH_WY only), e.g. to get the same hash values in
+ * several tables. Return 0 (success) or ENOTEMPTY (the table has items).
+ */
+int HT_set_seed( const HTable ht, unsigned long long seed );
+/*
+ * Set max number of buckets moved per HT_set(), HT_get() or HT_del() call
+ * while large table is resized incrementally (HT_REHASH_STEP by default).
+ * 0 disables incremental resize: whole table is rehashed at once. Do not
+ * affect HTF_FLAT tables. Return HTable pointer from arguments.
+ */
+HTable HT_rehash_step( const HTable ht, size_t step );
+
+/*
+ * Items are kept in insertion order list, ordered calls take O(n) and do
+ * not sort. Ordered cursor (do not allocate memory, the table must not be
+ * changed while it is used; to delete items get next one first):
+ *
+ *      for( e = HT_ordered_first( ht ); e; e = HT_ordered_next( ht, e ) ) {
+ *          ...
+ *      }
+ */
+HTItemConst HT_ordered_first( const HTable ht );
+HTItemConst HT_ordered_last( const HTable ht );
+HTItemConst HT_ordered_next( const HTable ht, HTItemConst item );
+HTItemConst HT_ordered_prev( const HTable ht, HTItemConst item );
+void HT_ordered_foreach( const HTable ht, HT_Foreach foreach, void *data );
 
 /*
  * Get hash table keys:
@@ -126,7 +319,13 @@ HTItemConst *HT_ordered_items( const HTable ht );
  */
 HTItemConst *HT_sorted_items( const HTable ht, HT_Compare compare );
 /*
- * Sort items array:
+ * Get first 'k' items with custom sorting (NULL terminated array), all
+ * items are not sorted:
+ */
+HTItemConst *HT_top_items( const HTable ht, HT_Compare compare, size_t k );
+/*
+ * Sort items array (large arrays are sorted by several threads when
+ * USE_LOCKING is defined):
  */
 HTItemConst *HT_sort_items( HTItemConst *items, size_t nitems,
                             HT_Compare compare );
@@ -143,6 +342,32 @@ void const *HT_val( const HTable ht, const void *key, size_t key_size );
  */
 int HT_del( const HTable ht, const void *key, size_t key_size );
 
+/*
+ * Same as above with precomputed key hash (must be HT_hash() value for
+ * this table), HT_val_h() reads item data under table lock:
+ */
+unsigned int HT_hash( const HTable ht, const void *key, size_t key_size );
+HTItemConst HT_set_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size, void *data );
+HTItemConst HT_get_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size );
+void const *HT_val_h( const HTable ht, unsigned int hash, const void *key,
+                      size_t key_size );
+int HT_del_h( const HTable ht, unsigned int hash, const void *key,
+              size_t key_size );
+
+/*
+ * Batch calls: 'keys' and 'sizes' are arrays of 'n' keys. All keys hashes
+ * are computed and their buckets prefetched before lookup, so memory loads
+ * for different keys overlap. HT_get_many() stores found items (or NULL)
+ * to 'items' and return number of found items. HT_set_many() stores 'n'
+ * items with 'data' values and return number of stored items.
+ */
+size_t HT_get_many( const HTable ht, const void *const *keys,
+                    const size_t *sizes, size_t n, HTItemConst *items );
+size_t HT_set_many( const HTable ht, const void *const *keys,
+                    const size_t *sizes, void *const *data, size_t n );
+
 /*
  * C-strings keys handling:
  * HT_set_c( ht, "fookey", data );
@@ -0,0 +1,394 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "htsnap.h"
+#include "crc.h"
+#include <errno.h>
+
+#if defined(__unix__)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+#endif
+
+#define HTS_ALIGN(n)        (((n) + 7) & ~(uint64_t)7)
+#define HTS_ITEM_SIZE(ks, ds) \
+    HTS_ALIGN( sizeof( struct _HTSnapItem ) + (ks) + (ds) )
+#define HTS_MIN_BUCKETS     16
+
+static size_t _HTS_Cstring_Size( const void *data )
+{
+    return data ? strlen( data ) + 1 : 0;
+}
+
+/*
+ * Internal, build buckets array and items image (as it is written to file)
+ * under table lock: items can not be deleted, replaced or moved by other
+ * threads meanwhile, keys and data are copied. Return 1 (success) or 0 (no
+ * memory).
+ */
+static int _HTS_Build( const HTable ht, HT_Data_Size data_size,
+                       HTSnapHeader *hdr, uint64_t **buckets, char **image )
+{
+    size_t *sizes;
+    HTItem e;
+    size_t i;
+    uint64_t off;
+    char *p;
+    int ok = 0;
+    __lock( ht->lock );
+    hdr->nitems = ht->nitems;
+    hdr->nbuckets = HTS_MIN_BUCKETS;
+
+    while( hdr->nbuckets < hdr->nitems ) {
+        hdr->nbuckets *= 2;
+    }
+
+    hdr->buckets = sizeof( HTSnapHeader );
+    hdr->items = hdr->buckets + hdr->nbuckets * sizeof( uint64_t );
+    *buckets = Calloc( hdr->nbuckets, sizeof( uint64_t ) );
+    sizes = Malloc( ( hdr->nitems + 1 ) * sizeof( size_t ) );
+
+    if( !*buckets || !sizes ) {
+        goto out;
+    }
+
+    off = hdr->items;
+
+    for( e = ht->ohead, i = 0; e; e = e->onext, i++ ) {
+        sizes[i] = data_size( e->data );
+        off += HTS_ITEM_SIZE( e->key.size, sizes[i] );
+    }
+
+    hdr->size = off;
+    *image = Malloc( off - hdr->items + 1 );
+
+    if( !*image ) {
+        goto out;
+    }
+
+    /*
+     * Items offsets are known, chain links are set at once:
+     */
+    off = hdr->items;
+    p = *image;
+
+    for( e = ht->ohead, i = 0; e; e = e->onext, i++ ) {
+        struct _HTSnapItem item;
+        size_t size = HTS_ITEM_SIZE( e->key.size, sizes[i] );
+        item.hash = crc32( e->key.key, e->key.size );
+        item.next = ( *buckets )[item.hash & ( hdr->nbuckets - 1 )];
+        item.order = e->order;
+        item.key_size = e->key.size;
+        item.data_size = sizes[i];
+        item.reserved = 0;
+        ( *buckets )[item.hash & ( hdr->nbuckets - 1 )] = off;
+        memset( p, 0, size );
+        memcpy( p, &item, sizeof( item ) );
+        memcpy( p + sizeof( item ), e->key.key, e->key.size );
+
+        if( sizes[i] ) {
+            memcpy( p + sizeof( item ) + e->key.size, e->data, sizes[i] );
+        }
+
+        p += size;
+        off += size;
+    }
+
+    ok = 1;
+out:
+    __unlock( ht->lock );
+    Free( sizes );
+    return ok;
+}
+
+/*
+ * Write table snapshot. Return 0 (success) or errno value.
+ */
+int HT_save( const HTable ht, const char *path, HT_Data_Size data_size )
+{
+    HTSnapHeader hdr;
+    uint64_t *buckets = NULL;
+    char *image = NULL;
+    char *tmp = NULL;
+    FILE *f = NULL;
+    int rc = ENOMEM;
+
+    if( !data_size ) {
+        data_size = _HTS_Cstring_Size;
+    }
+
+    memset( &hdr, 0, sizeof( hdr ) );
+    memcpy( hdr.magic, HTS_MAGIC, sizeof( hdr.magic ) );
+    tmp = Malloc( strlen( path ) + sizeof( ".tmp" ) );
+
+    if( !tmp || !_HTS_Build( ht, data_size, &hdr, &buckets, &image ) ) {
+        goto out;
+    }
+
+    strcpy( tmp, path );
+    strcat( tmp, ".tmp" );
+    f = fopen( tmp, "wb" );
+
+    if( !f ) {
+        rc = errno;
+        goto out;
+    }
+
+    rc = EIO;
+
+    if( fwrite( &hdr, sizeof( hdr ), 1, f ) != 1 ||
+            fwrite( buckets, sizeof( uint64_t ), hdr.nbuckets, f ) !=
+            hdr.nbuckets ||
+            fwrite( image, 1, hdr.size - hdr.items, f ) !=
+            hdr.size - hdr.items ) {
+        goto out;
+    }
+
+    rc = fclose( f ) ? errno : 0;
+    f = NULL;
+
+    if( !rc && rename( tmp, path ) ) {
+        rc = errno;
+    }
+
+out:
+
+    if( f ) {
+        fclose( f );
+    }
+
+    if( rc && tmp ) {
+        remove( tmp );
+    }
+
+    Free( tmp );
+    Free( image );
+    Free( buckets );
+    return rc;
+}
+
+/*
+ * Internal, check header. Return 1 (valid) or 0.
+ */
+static int _HTS_Valid( const char *map, size_t size )
+{
+    const HTSnapHeader *hdr = ( const HTSnapHeader * ) map;
+
+    if( size < sizeof( HTSnapHeader ) ||
+            memcmp( hdr->magic, HTS_MAGIC, sizeof( hdr->magic ) ) ||
+            hdr->size != size ) {
+        return 0;
+    }
+
+    if( !hdr->nbuckets || ( hdr->nbuckets & ( hdr->nbuckets - 1 ) ) ||
+            hdr->buckets != sizeof( HTSnapHeader ) ||
+            hdr->nbuckets > ( size - hdr->buckets ) / sizeof( uint64_t ) ||
+            hdr->items != hdr->buckets + hdr->nbuckets * sizeof( uint64_t ) ) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Internal, get item at offset. Return NULL if item does not fit into file.
+ */
+static HTSnapItem _HTS_Item( const HTSnap snap, uint64_t off )
+{
+    HTSnapItem item;
+
+    if( off < snap->hdr->items || off & 7 ||
+            off > snap->size - sizeof( struct _HTSnapItem ) ) {
+        return NULL;
+    }
+
+    item = ( HTSnapItem )( snap->map + off );
+
+    if( item->key_size > snap->size || item->data_size > snap->size ||
+            off + HTS_ITEM_SIZE( item->key_size, item->data_size ) >
+            snap->size ) {
+        return NULL;
+    }
+
+    return item;
+}
+
+/*
+ * Map snapshot file. Return snapshot or NULL.
+ */
+HTSnap HT_load_mmap( const char *path )
+{
+    HTSnap snap = Calloc( sizeof( struct _HTSnap ), 1 );
+#if defined(__unix__)
+    struct stat st;
+    void *map;
+    int fd;
+
+    if( !snap ) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    fd = open( path, O_RDONLY );
+
+    if( fd < 0 ) {
+        Free( snap );
+        return NULL;
+    }
+
+    if( fstat( fd, &st ) ) {
+        int err = errno;
+        close( fd );
+        Free( snap );
+        errno = err;
+        return NULL;
+    }
+
+    if( !st.st_size ) {
+        close( fd );
+        errno = EINVAL;
+        Free( snap );
+        return NULL;
+    }
+
+    map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+
+    if( map == MAP_FAILED ) {
+        Free( snap );
+        return NULL;
+    }
+
+    snap->map = map;
+    snap->size = st.st_size;
+    snap->mapped = 1;
+#else
+    /*
+     * No mmap(): read whole file.
+     */
+    FILE *f;
+    long size;
+
+    if( !snap ) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    f = fopen( path, "rb" );
+
+    if( !f ) {
+        Free( snap );
+        return NULL;
+    }
+
+    if( fseek( f, 0, SEEK_END ) || ( size = ftell( f ) ) <= 0 ||
+            fseek( f, 0, SEEK_SET ) ||
+            !( snap->map = Malloc( size ) ) ||
+            fread( ( char * ) snap->map, 1, size, f ) != ( size_t ) size ) {
+        fclose( f );
+        Free( ( char * ) snap->map );
+        Free( snap );
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fclose( f );
+    snap->size = size;
+#endif
+
+    if( !_HTS_Valid( snap->map, snap->size ) ) {
+        HT_snap_close( snap );
+        errno = EINVAL;
+        return NULL;
+    }
+
+    snap->hdr = ( const HTSnapHeader * ) snap->map;
+    snap->buckets = ( const uint64_t * )( snap->map + snap->hdr->buckets );
+    return snap;
+}
+
+void HT_snap_close( HTSnap snap )
+{
+#if defined(__unix__)
+
+    if( snap->mapped ) {
+        munmap( ( void * ) snap->map, snap->size );
+    }
+
+#endif
+
+    if( !snap->mapped ) {
+        Free( ( char * ) snap->map );
+    }
+
+    Free( snap );
+}
+
+HTSnapItem HT_snap_get( const HTSnap snap, const void *key, size_t key_size )
+{
+    uint32_t hash = crc32( key, key_size );
+    uint64_t off = snap->buckets[hash & ( snap->hdr->nbuckets - 1 )];
+
+    while( off ) {
+        HTSnapItem item = _HTS_Item( snap, off );
+
+        if( !item ) {
+            return NULL;
+        }
+
+        if( item->hash == hash && item->key_size == key_size &&
+                !memcmp( HTS_KEY( item ), key, key_size ) ) {
+            return item;
+        }
+
+        /*
+         * HT_save() links every item to the previous one of its bucket, so
+         * offsets decrease along a chain. Other links (cycles in corrupted
+         * file) are rejected:
+         */
+        if( item->next >= off ) {
+            return NULL;
+        }
+
+        off = item->next;
+    }
+
+    return NULL;
+}
+
+const void *HT_snap_val( const HTSnap snap, const void *key,
+                         size_t key_size, size_t *data_size )
+{
+    HTSnapItem item = HT_snap_get( snap, key, key_size );
+
+    if( data_size ) {
+        *data_size = item ? item->data_size : 0;
+    }
+
+    return item ? HTS_DATA( item ) : NULL;
+}
+
+void HT_snap_foreach( const HTSnap snap, HTS_Foreach foreach, void *data )
+{
+    uint64_t i;
+    uint64_t off = snap->hdr->items;
+
+    for( i = 0; i < snap->hdr->nitems; i++ ) {
+        HTSnapItem item = _HTS_Item( snap, off );
+
+        if( !item ) {
+            return;
+        }
+
+        foreach( item, data );
+        off += HTS_ITEM_SIZE( item->key_size, item->data_size );
+    }
+}
+
+/*
+ *  That's All, Folks!
+ */
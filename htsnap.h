@@ -0,0 +1,102 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef HTSNAP_H_
+#define HTSNAP_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "htable.h"
+#include <stdint.h>
+
+/*
+ * HTable snapshot: position independent file which is memory-mapped and
+ * queried read-only as is, without rebuilding the table. All references
+ * inside the file are offsets from its beginning. Keys and data are stored
+ * as byte blobs, items are laid out in insertion order. Keys are hashed
+ * with crc32(), so the file does not depend on table hash function. Byte
+ * order is native: files are not portable between big- and little-endian
+ * machines.
+ *
+ * File layout: header, buckets array (nbuckets offsets of first item in
+ * bucket chain, 0 for empty bucket), items. Every item is 8 bytes aligned
+ * and followed by key bytes and data bytes.
+ */
+#define HTS_MAGIC       "HTSNAP\0\1"
+
+typedef struct _HTSnapHeader {
+    char magic[8];
+    uint64_t size;              /* whole file size */
+    uint64_t nitems;
+    uint64_t nbuckets;          /* power of 2 */
+    uint64_t buckets;           /* buckets array offset */
+    uint64_t items;             /* first item offset */
+} HTSnapHeader;
+
+typedef struct _HTSnapItem {
+    uint64_t next;              /* previous item of bucket chain or 0 */
+    uint64_t order;
+    uint64_t key_size;
+    uint64_t data_size;
+    uint32_t hash;
+    uint32_t reserved;
+} const *HTSnapItem;
+
+#define HTS_KEY(item)   ((const void *)((item) + 1))
+#define HTS_DATA(item)  ((const void *)((const char *)((item) + 1) + \
+                        (item)->key_size))
+
+typedef struct _HTSnap {
+    const char *map;
+    size_t size;
+    const HTSnapHeader *hdr;
+    const uint64_t *buckets;
+    int mapped;
+} *HTSnap;
+
+/*
+ * Return stored size of item data. NULL for HT_save() means C-strings,
+ * stored with terminating 0. Called with table lock held, must not call
+ * HT_*() on the same table.
+ */
+typedef size_t ( *HT_Data_Size )( const void *data );
+typedef void ( *HTS_Foreach )( HTSnapItem item, void *data );
+
+/*
+ * Write table snapshot to 'path' (via temporary file 'path'.tmp renamed
+ * on success). Items are copied under table lock, so other threads may
+ * change the table meanwhile. Return 0 (success) or errno value.
+ */
+int HT_save( const HTable ht, const char *path, HT_Data_Size data_size );
+/*
+ * Map snapshot file. Return snapshot or NULL (errno is set, EINVAL for
+ * malformed file).
+ */
+HTSnap HT_load_mmap( const char *path );
+void HT_snap_close( HTSnap snap );
+
+/*
+ * Lookup. HT_snap_val() return item data or NULL, its size is stored to
+ * 'data_size' if it is not NULL:
+ */
+HTSnapItem HT_snap_get( const HTSnap snap, const void *key, size_t key_size );
+const void *HT_snap_val( const HTSnap snap, const void *key,
+                         size_t key_size, size_t *data_size );
+/*
+ * Iterate items in insertion order:
+ */
+void HT_snap_foreach( const HTSnap snap, HTS_Foreach foreach, void *data );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* HTSNAP_H_ */
+
+/*
+ *  That's All, Folks!
+ */
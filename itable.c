@@ -0,0 +1,340 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "itable.h"
+
+#define IT_MASK(it)     ((it)->size - 1)
+
+/*
+ * Internal, MurmurHash3 64-bit finalizer: every key bit affects low bits
+ * used as slot index, so sequential ids do not make long probe runs.
+ */
+static inline size_t _IT_Hash( IT_Key key )
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return ( size_t ) key;
+}
+
+/*
+ * Internal, get slot with given key or first empty slot of its probe run.
+ */
+static inline ITItem _IT_Slot( const ITable it, IT_Key key )
+{
+    size_t mask = IT_MASK( it );
+    size_t i = _IT_Hash( key ) & mask;
+
+    while( it->items[i].key && it->items[i].key != key ) {
+        i = ( i + 1 ) & mask;
+    }
+
+    return &it->items[i];
+}
+
+/*
+ * Internal, move all items to new array. Return 1 (success) or 0 (failed).
+ * Do not change internal error code.
+ */
+static int _IT_Rehash( const ITable it, size_t newsize )
+{
+    size_t i;
+    struct _ITItem *old = it->items;
+    size_t oldsize = it->size;
+    struct _ITItem *items = Calloc( newsize, sizeof( struct _ITItem ) );
+
+    if( !items ) {
+        return 0;
+    }
+
+    it->items = items;
+    it->size = newsize;
+
+    for( i = 0; i < oldsize; i++ ) {
+        if( old[i].key ) {
+            *_IT_Slot( it, old[i].key ) = old[i];
+        }
+    }
+
+    Free( old );
+    return 1;
+}
+
+/*
+ * Create integer keys table. Return created table or NULL.
+ */
+ITable IT_create( size_t size, IT_Destructor destructor )
+{
+    const ITable it = Malloc( sizeof( struct _ITable ) );
+
+    if( !it ) {
+        return NULL;
+    }
+
+    it->size = IT_MIN_SIZE;
+
+    while( it->size < size ) {
+        it->size *= 2;
+    }
+
+    it->items = Calloc( it->size, sizeof( struct _ITItem ) );
+
+    if( !it->items ) {
+        Free( it );
+        return NULL;
+    }
+
+    it->nitems = 0;
+    it->has_zero = 0;
+    it->zero.key = 0;
+    it->zero.data = NULL;
+    it->min_size = it->size;
+    it->destructor = destructor;
+    it->error = 0;
+    __initlock( it->lock );
+    return it;
+}
+
+/*
+ * Delete all items:
+ */
+void IT_clear( const ITable it )
+{
+    size_t i;
+    __lock( it->lock );
+
+    if( it->destructor ) {
+        for( i = 0; i < it->size; i++ ) {
+            if( it->items[i].key ) {
+                it->destructor( it->items[i].data );
+            }
+        }
+
+        if( it->has_zero ) {
+            it->destructor( it->zero.data );
+        }
+    }
+
+    memset( it->items, 0, it->size * sizeof( struct _ITItem ) );
+    it->zero.data = NULL;
+    it->has_zero = 0;
+    it->nitems = 0;
+    it->error = 0;
+    __unlock( it->lock );
+}
+
+/*
+ * Destroy table:
+ */
+void IT_destroy( const ITable it )
+{
+    IT_clear( it );
+    Free( it->items );
+    Free( it );
+}
+
+/*
+ * Foreach iterator:
+ */
+void IT_foreach( const ITable it, IT_Foreach foreach, void *data )
+{
+    size_t i;
+    __lock( it->lock );
+
+    if( it->has_zero ) {
+        foreach( &it->zero, data );
+    }
+
+    for( i = 0; i < it->size; i++ ) {
+        if( it->items[i].key ) {
+            foreach( &it->items[i], data );
+        }
+    }
+
+    __unlock( it->lock );
+}
+
+/*
+ * Internal, find item. Return item or NULL.
+ */
+static ITItem _IT_Get( const ITable it, IT_Key key )
+{
+    ITItem e;
+
+    if( !key ) {
+        return it->has_zero ? &it->zero : NULL;
+    }
+
+    e = _IT_Slot( it, key );
+    return e->key ? e : NULL;
+}
+
+/*
+ * Get hash table item. Return item found or NULL. Set internal error code.
+ */
+ITItemConst IT_get( const ITable it, IT_Key key )
+{
+    ITItem e;
+    __lock( it->lock );
+    e = _IT_Get( it, key );
+    it->error = e ? 0 : ENOKEY;
+    __unlock( it->lock );
+    return e;
+}
+
+/*
+ * Get hash table item data. Return data found or NULL. Set internal error
+ * code.
+ */
+void const *IT_val( const ITable it, IT_Key key )
+{
+    ITItem e;
+    void const *data;
+    __lock( it->lock );
+    e = _IT_Get( it, key );
+    it->error = e ? 0 : ENOKEY;
+    data = e ? e->data : NULL;
+    __unlock( it->lock );
+    return data;
+}
+
+/*
+ * Set item data. Old data will be deleted with destructor. Return item or
+ * NULL. Set internal error code.
+ */
+ITItemConst IT_set( const ITable it, IT_Key key, void *data )
+{
+    ITItem e;
+    size_t n;
+    __lock( it->lock );
+
+    if( !key ) {
+        e = &it->zero;
+
+        if( it->has_zero ) {
+            if( it->destructor ) {
+                it->destructor( e->data );
+            }
+        }
+        else {
+            it->has_zero = 1;
+            it->nitems++;
+        }
+
+        e->data = data;
+        it->error = 0;
+        __unlock( it->lock );
+        return e;
+    }
+
+    e = _IT_Slot( it, key );
+
+    if( e->key ) {
+        if( it->destructor ) {
+            it->destructor( e->data );
+        }
+
+        e->data = data;
+        it->error = 0;
+        __unlock( it->lock );
+        return e;
+    }
+
+    /*
+     * New key. If table can not be expanded item is still stored while
+     * there is at least one free slot left:
+     */
+    n = it->nitems - it->has_zero + 1;
+
+    if( n * 100 > it->size * IT_GROW_LOAD ) {
+        if( _IT_Rehash( it, it->size * 2 ) ) {
+            e = _IT_Slot( it, key );
+        }
+        else if( n >= it->size ) {
+            it->error = ENOMEM;
+            __unlock( it->lock );
+            return NULL;
+        }
+    }
+
+    e->key = key;
+    e->data = data;
+    it->nitems++;
+    it->error = 0;
+    __unlock( it->lock );
+    return e;
+}
+
+/*
+ * Delete item. Following items of the probe run are shifted back, so the
+ * table never has deleted slots markers.
+ */
+int IT_del( const ITable it, IT_Key key )
+{
+    ITItem e;
+    size_t i, j, k;
+    size_t mask = IT_MASK( it );
+    __lock( it->lock );
+    e = _IT_Get( it, key );
+
+    if( !e ) {
+        it->error = ENOKEY;
+        __unlock( it->lock );
+        return ENOKEY;
+    }
+
+    if( it->destructor ) {
+        it->destructor( e->data );
+    }
+
+    it->nitems--;
+    it->error = 0;
+
+    if( !key ) {
+        it->has_zero = 0;
+        it->zero.data = NULL;
+        __unlock( it->lock );
+        return 0;
+    }
+
+    i = j = ( size_t )( e - it->items );
+
+    for( ;; ) {
+        j = ( j + 1 ) & mask;
+
+        if( !it->items[j].key ) {
+            break;
+        }
+
+        k = _IT_Hash( it->items[j].key ) & mask;
+
+        /*
+         * Item stays if its home slot lies cyclically in (i, j]:
+         */
+        if( i <= j ? ( i < k && k <= j ) : ( i < k || k <= j ) ) {
+            continue;
+        }
+
+        it->items[i] = it->items[j];
+        i = j;
+    }
+
+    it->items[i].key = 0;
+    it->items[i].data = NULL;
+
+    if( it->size > it->min_size &&
+            ( it->nitems - it->has_zero ) * 100 < it->size * IT_SHRINK_LOAD ) {
+        _IT_Rehash( it, it->size / 2 );
+    }
+
+    __unlock( it->lock );
+    return 0;
+}
+
+/*
+ *  That's All, Folks!
+ */
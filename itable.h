@@ -0,0 +1,92 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef ITABLE_H_
+#define ITABLE_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "config.h"
+#include "_lock.h"
+#include <errno.h>
+
+/*
+ * Hash table with integer keys. Keys are stored as native words in one
+ * contiguous array (open addressing, linear probing), hashed with integer
+ * mixer and compared with '==': no key copies, no byte buffers hashing, no
+ * memcmp(). Use it instead of HT_set_int(), HT_get_ulong() etc. for hot
+ * id-indexed lookups.
+ */
+#define IT_MIN_SIZE     64
+/*
+ * Load factors in percents: the table is expanded when load goes above
+ * IT_GROW_LOAD and reduced when it goes below IT_SHRINK_LOAD:
+ */
+#define IT_GROW_LOAD    75
+#define IT_SHRINK_LOAD  15
+
+typedef unsigned long long IT_Key;
+
+typedef struct _ITItem {
+    IT_Key key;
+    void *data;
+} *ITItem;
+
+typedef struct _ITItem const *ITItemConst;
+
+typedef void ( *IT_Destructor )( void *data );
+typedef void ( *IT_Foreach )( const ITItemConst item, void *data );
+
+/*
+ * Key 0 marks empty slots, item with key 0 is kept apart ('zero').
+ */
+typedef struct _ITable {
+    size_t size;
+    size_t nitems;
+    struct _ITItem *items;
+    struct _ITItem zero;
+    int has_zero;
+    size_t min_size;
+    IT_Destructor destructor;
+    int error;
+    __lock_t( lock );
+} *ITable;
+
+/*
+ * 'size' will be rounded up to the next highest power of 2, can be 0 or
+ * < IT_MIN_SIZE (IT_MIN_SIZE will be used), the table is never reduced
+ * below it. 'destructor' is a function to delete elements data, can be
+ * NULL.
+ */
+ITable IT_create( size_t size, IT_Destructor destructor );
+void IT_clear( const ITable it );
+void IT_destroy( const ITable it );
+
+void IT_foreach( const ITable it, IT_Foreach foreach, void *data );
+
+/*
+ * Used error codes (ITable.error): 0 (no errors), ENOKEY, ENOMEM
+ * WARNING: ITItemConst pointers returned by IT_set() and IT_get() are valid
+ * only until the next IT_set() or IT_del() call (items can be moved).
+ */
+ITItemConst IT_set( const ITable it, IT_Key key, void *data );
+ITItemConst IT_get( const ITable it, IT_Key key );
+void const *IT_val( const ITable it, IT_Key key );
+/*
+ * Return ENOKEY or 0 (success):
+ */
+int IT_del( const ITable it, IT_Key key );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* ITABLE_H_ */
+
+/*
+ *  That's All, Folks!
+ */
@@ -26,12 +26,84 @@ List lcreate( L_destructor destructor )
     return list;
 }
 
+List lcreate_slab( L_destructor destructor, Slab nodes )
+{
+    List list;
+
+    if( nodes->obj_size < sizeof( struct _LNode ) ) {
+        return NULL;
+    }
+
+    list = lcreate( destructor );
+
+    if( list ) {
+        list->slab = nodes;
+    }
+
+    return list;
+}
+
+List lcreate_arena( L_destructor destructor, Arena arena )
+{
+    List list = arena_calloc( arena, sizeof( struct _List ), 1 );
+
+    if( !list ) {
+        return NULL;
+    }
+
+    list->destructor = destructor;
+    list->arena = arena;
+    __initlock( list->lock );
+    return list;
+}
+
+/*
+ * Internal, new zeroed node:
+ */
+static LNode _lnode_alloc( List list )
+{
+    LNode node;
+
+    if( list->arena ) {
+        return arena_calloc( list->arena, sizeof( struct _LNode ), 1 );
+    }
+
+    if( !list->slab ) {
+        return Calloc( sizeof( struct _LNode ), 1 );
+    }
+
+    node = slab_alloc( list->slab );
+
+    if( node ) {
+        memset( node, 0, sizeof( struct _LNode ) );
+    }
+
+    return node;
+}
+
+static void _lnode_free( List list, LNode node )
+{
+    if( list->arena ) {
+        return;
+    }
+
+    if( list->slab ) {
+        slab_free( list->slab, node );
+    }
+    else {
+        Free( node );
+    }
+}
+
 void lclear( List list )
 {
     if( list ) {
         LNode node;
         __lock( list->lock );
-        node = list->head;
+        /*
+         * Arena nodes are not freed one by one:
+         */
+        node = ( list->arena && !list->destructor ) ? NULL : list->head;
 
         while( node ) {
             LNode lcurrent = node;
@@ -41,7 +113,7 @@ void lclear( List list )
                 list->destructor( lcurrent->data );
             }
 
-            Free( lcurrent );
+            _lnode_free( list, lcurrent );
         }
 
         list->head = list->tail = list->cursor = NULL;
@@ -53,7 +125,10 @@ void lclear( List list )
 void ldestroy( List list )
 {
     lclear( list );
-    Free( list );
+
+    if( list && !list->arena ) {
+        Free( list );
+    }
 }
 
 void *ladd( List list, void *data )
@@ -61,7 +136,7 @@ void *ladd( List list, void *data )
     if( list && data ) {
         LNode  node;
         __lock( list->lock );
-        node = Calloc( sizeof( struct _LNode ), 1 );
+        node = _lnode_alloc( list );
 
         if( !node ) {
             __unlock( list->lock );
@@ -92,7 +167,7 @@ void *lpoke( List list, void *data )
     if( list && data ) {
         LNode  node;
         __lock( list->lock );
-        node = Calloc( sizeof( struct _LNode ), 1 );
+        node = _lnode_alloc( list );
 
         if( !node ) {
             __unlock( list->lock );
@@ -163,7 +238,7 @@ void *lgethead( List list )
         data = list->head->data;
         node = list->head;
         list->head = list->head->next;
-        Free( node );
+        _lnode_free( list, node );
 
         if( list->head ) {
             list->head->prev = NULL;
@@ -191,7 +266,7 @@ void *lgettail( List list )
         data = list->tail->data;
         node = list->tail;
         list->tail = list->tail->prev;
-        Free( node );
+        _lnode_free( list, node );
 
         if( list->tail ) {
             list->tail->next = NULL;
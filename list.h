@@ -10,6 +10,8 @@
 
 #include "config.h"
 #include "_lock.h"
+#include "slab.h"
+#include "arena.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -30,6 +32,8 @@ typedef struct _List {
     LNode tail;
     LNode cursor;
     L_destructor destructor;
+    Slab slab;
+    Arena arena;
     size_t size;
     __lock_t( lock );
 } *List;
@@ -41,6 +45,20 @@ void list_Free( void *data );
 #define LD_DEF  list_Free
 
 List lcreate( L_destructor destructor );
+/*
+ * Same as lcreate(), list nodes are allocated from 'nodes' slab (see
+ * slab.h), its objects must be at least sizeof(struct _LNode) bytes. One
+ * slab can be shared by many lists, it must be destroyed after them.
+ * Return NULL if slab objects are too small.
+ */
+List lcreate_slab( L_destructor destructor, Slab nodes );
+/*
+ * Same as lcreate(), list and its nodes are allocated from 'arena' (see
+ * arena.h) and are released by arena_reset() / arena_destroy(). Removed
+ * nodes are not freed, lclear() and ldestroy() only call 'destructor' (no
+ * list walk at all if it is NULL).
+ */
+List lcreate_arena( L_destructor destructor, Arena arena );
 void ldestroy( List list );
 /*
  * lclear() remove all list elements
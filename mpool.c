@@ -8,22 +8,40 @@
 #include "mpool.h"
 #include <string.h>
 
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+# define MP_TCACHE
+# include <pthread.h>
+#endif
+
+#if !defined(__WINDOWS__)
+# define MP_MMAP
+# include <sys/mman.h>
+#endif
+
 /* ---------------------------------------------------------------------------*/
 
 /*
  * mpool.pool structure:
  *
- * +---- struct _mblk ---+  allocated +---- struct _mblk ---+  allocated +---
- * |                     |   memory   |                     |    memory  |
- * +--------+-----+------+------------+--------+-----+------+------------+---
- * | 0x1515 | 0x0 | size | size_bytes | 0x1515 | 0x0 | size | size_bytes |
- * +--------+-----+------+------------+--------+-----+------+------------+---
- *      ^      ^     ^         ^
+ * +---- struct _mblk ---+  allocated +------+---- struct _mblk ---+---
+ * |                     |   memory   |      |                     |
+ * +--------+-----+------+------------+------+--------+-----+------+---
+ * | 0x1515 | 0x0 | size | size_bytes | tag  | 0x1515 | 0x0 | size |
+ * +--------+-----+------+------------+------+--------+-----+------+---
+ *      ^      ^     ^         ^         ^
+ *      |      |     |         |         +---- boundary tag: size | free bit
  *      |      |     |         +---- memory returned by mp_alloc()
  *      |      |     +---- block size
  *      |      +---- flags
  *      +---- block signature
+ *
+ * Boundary tag is a copy of block size (MB_TAG_FREE bit is set for free
+ * blocks), so the previous block is found from the next one, and mp_free()
+ * merges freed block with both free neighbours at once.
  */
+#define MB_TAG_FREE     ((size_t)1)
+#define MB_OVERHEAD     (sizeof(struct _mblk) + sizeof(size_t))
+#define MB_FREE_MIN     (2 * sizeof(mblk))   /* free block holds bins links */
 
 #if defined(DEBUG)
 
@@ -32,133 +50,915 @@ static void *_mp_malloc( size_t size )
     void *ptr = malloc( size );
 
     if( ptr ) {
-        memset( ptr, '#', size );
+        memset( ptr, '#', size );
+    }
+
+    return ptr;
+}
+
+static int MP_VALID( void *ptr, mpool mp )
+{
+    if( ( char * )( ptr ) < mp->min || ( char * )( ptr ) > mp->max ) {
+        return 0;
+    }
+
+    return ( ( ( ( struct _mblk * )( ptr ) ) - 1 )->signature == MBLK_SIGNATURE );
+}
+
+static int MB_VALID( mblk mb, mpool mp )
+{
+    if( ( char * )( mb + 1 ) < mp->min || ( char * )( mb + 1 ) > mp->max ) {
+        return 0;
+    }
+
+    return ( mb->signature == MBLK_SIGNATURE );
+}
+
+static mblk MB_NEXT( mblk mb )
+{
+    return ( mblk )( ( char * )( mb ) + MB_OVERHEAD + mb->size );
+}
+
+#else
+
+#define MP_VALID(ptr, mp) \
+    ((char *)(ptr) >= (mp)->min && \
+    (char *)(ptr) <= (mp)->max && \
+    (((struct _mblk *)(ptr)) - 1)->signature == MBLK_SIGNATURE)
+
+#define MB_VALID(mb, mp) \
+    ((char *)((mb)+1) >= (mp)->min && \
+    (char *)((mb)+1) <= (mp)->max && \
+    (mb)->signature == MBLK_SIGNATURE)
+
+#define MB_NEXT(mb) \
+        (mblk)((char *)(mb) + MB_OVERHEAD + (mb)->size)
+
+#define _mp_malloc(size) malloc( (size) )
+
+#endif
+
+#define MS_ALIGN(size, min) \
+    if( (size) < (min) ) (size) = (min); \
+    (size) += (sizeof(size_t) - 1); \
+    (size) &= ~(sizeof(size_t) - 1)
+
+static mpool _mp = NULL;
+static int _mp_atexit = 0;
+static size_t _mp_gen = 0;
+
+/*
+ * Tags may be unaligned, they are copied:
+ */
+static inline void _mb_set_tag( mblk mb, int free )
+{
+    size_t tag = mb->size | ( free ? MB_TAG_FREE : 0 );
+    memcpy( ( char * )( mb + 1 ) + mb->size, &tag, sizeof( size_t ) );
+}
+
+/*
+ * Internal. Previous block if it is free, NULL otherwise:
+ */
+static inline mblk _mb_prev_free( const mpool mp, mblk mb )
+{
+    size_t tag;
+
+    if( ( char * ) mb == mp->pool ) {
+        return NULL;
+    }
+
+    memcpy( &tag, ( char * ) mb - sizeof( size_t ), sizeof( size_t ) );
+    return ( tag & MB_TAG_FREE ) ? ( mblk )( ( char * ) mb - MB_OVERHEAD -
+            ( tag & ~MB_TAG_FREE ) ) : NULL;
+}
+
+static void _mp_destroy( void )
+{
+    mp_destroy( _mp );
+}
+
+/*
+ * Internal. Default mpool, created at first use (only one of racing threads
+ * installs its pool).
+ */
+static mpool _mp_default( void )
+{
+    mpool mp = __atomic_load_n( &_mp, __ATOMIC_ACQUIRE );
+
+    if( !mp ) {
+        mpool created = mp_create( 0, MPF_EXPAND | MPF_TCACHE );
+
+        if( created && !__atomic_compare_exchange_n( &_mp, &mp, created, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+            mp_destroy( created );
+        }
+        else {
+            mp = created;
+        }
+    }
+
+    return mp;
+}
+
+#define MP_SET(mp) \
+    if( !mp ) { \
+    mp = _mp_default(); }
+
+/*
+ * Check for all mpools in chain. Pools memory is never moved and new
+ * pools are linked with release stores, so the chain can be walked
+ * without lock:
+ */
+static int _mp_valid_ptr( void *ptr, const mpool mp )
+{
+    mpool current = mp;
+
+    if( !ptr ) {
+        return 0;
+    }
+
+    while( current ) {
+        if( MP_VALID( ptr, current ) ) {
+            return 1;
+        }
+
+        current = __atomic_load_n( &current->next, __ATOMIC_ACQUIRE );
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------*/
+
+/*
+ * Segregated free lists (MPF_BINS), TLSF-like: free blocks are kept in
+ * lists by size class, first level is power of 2, second level splits it
+ * into MP_SL_COUNT equal ranges (blocks below MP_SMALL_BLOCK are split by
+ * MP_SMALL_BLOCK / MP_SL_COUNT bytes). Bitmaps of non-empty lists give the
+ * first suitable list in O(1). Free block memory holds list links, so free
+ * block size is at least MB_FREE_MIN.
+ */
+#define MP_SL_LOG2          4
+#define MP_SL_COUNT         (1 << MP_SL_LOG2)
+#define MP_FL_SHIFT         (MP_SL_LOG2 + 4)
+#define MP_SMALL_BLOCK      ((size_t)1 << MP_FL_SHIFT)
+#define MP_FL_COUNT         (sizeof(size_t) * 8 - MP_FL_SHIFT + 1)
+
+struct _mp_bins {
+    size_t fl_map;
+    unsigned int sl_map[MP_FL_COUNT];
+    mblk heads[MP_FL_COUNT][MP_SL_COUNT];
+};
+
+/*
+ * Block memory may be unaligned, links are copied:
+ */
+static inline mblk _mb_link( mblk mb, int i )
+{
+    mblk link;
+    memcpy( &link, ( char * )( mb + 1 ) + i * sizeof( mblk ), sizeof( mblk ) );
+    return link;
+}
+
+static inline void _mb_set_link( mblk mb, int i, mblk link )
+{
+    memcpy( ( char * )( mb + 1 ) + i * sizeof( mblk ), &link, sizeof( mblk ) );
+}
+
+#define MB_LINK_NEXT        0
+#define MB_LINK_PREV        1
+
+static inline unsigned int _mp_log2( size_t size )
+{
+    return sizeof( unsigned long long ) * 8 - 1 -
+           __builtin_clzll( ( unsigned long long ) size );
+}
+
+static inline void _mp_mapping( size_t size, unsigned int *fl,
+                                unsigned int *sl )
+{
+    if( size < MP_SMALL_BLOCK ) {
+        *fl = 0;
+        *sl = ( unsigned int )( size / ( MP_SMALL_BLOCK / MP_SL_COUNT ) );
+    }
+    else {
+        unsigned int t = _mp_log2( size );
+        *sl = ( unsigned int )( size >> ( t - MP_SL_LOG2 ) ) ^ MP_SL_COUNT;
+        *fl = t - MP_FL_SHIFT + 1;
+    }
+}
+
+static void _mp_bins_insert( struct _mp_bins *bins, mblk mb )
+{
+    unsigned int fl, sl;
+    mblk head;
+    _mp_mapping( mb->size, &fl, &sl );
+    head = bins->heads[fl][sl];
+    _mb_set_link( mb, MB_LINK_NEXT, head );
+    _mb_set_link( mb, MB_LINK_PREV, NULL );
+
+    if( head ) {
+        _mb_set_link( head, MB_LINK_PREV, mb );
+    }
+
+    bins->heads[fl][sl] = mb;
+    bins->fl_map |= ( size_t ) 1 << fl;
+    bins->sl_map[fl] |= 1U << sl;
+}
+
+static void _mp_bins_remove( struct _mp_bins *bins, mblk mb )
+{
+    unsigned int fl, sl;
+    mblk next = _mb_link( mb, MB_LINK_NEXT );
+    mblk prev = _mb_link( mb, MB_LINK_PREV );
+    _mp_mapping( mb->size, &fl, &sl );
+
+    if( next ) {
+        _mb_set_link( next, MB_LINK_PREV, prev );
+    }
+
+    if( prev ) {
+        _mb_set_link( prev, MB_LINK_NEXT, next );
+    }
+    else {
+        bins->heads[fl][sl] = next;
+
+        if( !next ) {
+            bins->sl_map[fl] &= ~( 1U << sl );
+
+            if( !bins->sl_map[fl] ) {
+                bins->fl_map &= ~( ( size_t ) 1 << fl );
+            }
+        }
+    }
+}
+
+/*
+ * Internal. Find free block of at least 'size' bytes: size is rounded up
+ * to the next class, so any block of the first non-empty list fits.
+ */
+static mblk _mp_bins_find( const struct _mp_bins *bins, size_t size )
+{
+    unsigned int fl, sl;
+    size_t map;
+    size_t step = size < MP_SMALL_BLOCK ? MP_SMALL_BLOCK / MP_SL_COUNT :
+                  ( size_t ) 1 << ( _mp_log2( size ) - MP_SL_LOG2 );
+
+    if( size > ( size_t ) - 1 - step ) {
+        return NULL;
+    }
+
+    _mp_mapping( size + step - 1, &fl, &sl );
+
+    if( fl >= MP_FL_COUNT ) {
+        return NULL;
+    }
+
+    map = bins->sl_map[fl] & ( ~0U << sl );
+
+    if( !map ) {
+        map = fl + 1 < MP_FL_COUNT ? bins->fl_map & ( ~( size_t ) 0 << ( fl + 1 ) ) :
+              0;
+
+        if( !map ) {
+            return NULL;
+        }
+
+        fl = __builtin_ctzll( map );
+        map = bins->sl_map[fl];
+    }
+
+    sl = __builtin_ctzll( map );
+    return bins->heads[fl][sl];
+}
+
+/*
+ * Internal. Mark free block 'best' busy, split it if the rest can hold
+ * another free block. Call with lock held.
+ */
+static void *_mp_use_block( const mpool mp, mblk best, size_t size )
+{
+    if( best->size >= size + MB_OVERHEAD + MB_FREE_MIN ) {
+        /* split block */
+        mblk mb = ( mblk )( ( char * ) best + MB_OVERHEAD + size );
+        mb->signature = MBLK_SIGNATURE;
+        mb->flags = 0;
+        mb->size = best->size - size - MB_OVERHEAD;
+        _mb_set_tag( mb, 1 );
+        best->size = size;
+
+        if( mp->bins ) {
+            _mp_bins_insert( mp->bins, mb );
+        }
+        else {
+            mp->last = mb;
+        }
+    }
+
+    best->flags = MBF_BUSY;
+    _mb_set_tag( best, 0 );
+    return best + 1;
+}
+
+/*
+ * Internal. Allocate from pool bins. 'size' is aligned.
+ */
+static void *_mp_bins_alloc( const mpool mp, size_t size )
+{
+    mblk best = _mp_bins_find( mp->bins, size );
+
+    if( !best ) {
+        return NULL;
+    }
+
+    _mp_bins_remove( mp->bins, best );
+    return _mp_use_block( mp, best, size );
+}
+
+/*
+ * Internal. Return busy block to pool, merge it with free neighbours.
+ * Headers of merged blocks are invalidated, so stale pointers to them are
+ * not accepted by mp_free(). Call with lock held.
+ */
+static void _mp_free_mb( const mpool mp, mblk mb )
+{
+    mblk prev = _mb_prev_free( mp, mb );
+    mblk next = MB_NEXT( mb );
+
+    mb->flags = 0;
+
+    if( MB_VALID( next, mp ) && !( next->flags & MBF_BUSY ) ) {
+        if( mp->bins ) {
+            _mp_bins_remove( mp->bins, next );
+        }
+
+        if( mp->last == next ) {
+            mp->last = mb;
+        }
+
+        mb->size += next->size + MB_OVERHEAD;
+        next->signature = 0;
+    }
+
+    if( prev ) {
+        if( mp->bins ) {
+            _mp_bins_remove( mp->bins, prev );
+        }
+
+        if( mp->last == mb ) {
+            mp->last = prev;
+        }
+
+        prev->size += mb->size + MB_OVERHEAD;
+        mb->signature = 0;
+        mb = prev;
+    }
+
+    _mb_set_tag( mb, 1 );
+
+    if( mp->bins ) {
+        _mp_bins_insert( mp->bins, mb );
+    }
+}
+
+/* ---------------------------------------------------------------------------*/
+
+#if defined(MP_MMAP)
+
+/*
+ * Internal. Touch every page of mapped region:
+ */
+static void _mp_prefault( char *ptr, size_t size, size_t page )
+{
+    size_t i;
+
+    for( i = 0; i < size; i += page ) {
+        ptr[i] = 0;
+    }
+}
+
+/*
+ * Internal. Map at least '*size' bytes, '*size' is set to mapped size.
+ * Return mapped memory or NULL.
+ */
+static char *_mp_map( size_t *size, mp_flags flags )
+{
+    size_t page = ( size_t ) sysconf( _SC_PAGESIZE );
+    int mflags = MAP_PRIVATE | MAP_ANONYMOUS;
+    int populate = 0;
+    char *ptr = MAP_FAILED;
+    char *map;
+#if defined(MAP_POPULATE)
+
+    if( flags & MPF_POPULATE ) {
+        populate = MAP_POPULATE;
+    }
+
+#endif
+
+    if( flags & MPF_HUGE ) {
+        page = MP_HUGE_PAGE;
+    }
+
+    *size = ( *size + page - 1 ) & ~( page - 1 );
+
+    if( !( flags & MPF_HUGE ) ) {
+        ptr = mmap( NULL, *size, PROT_READ | PROT_WRITE, mflags | populate, -1,
+                    0 );
+
+        if( ptr != MAP_FAILED && ( flags & MPF_POPULATE ) && !populate ) {
+            _mp_prefault( ptr, *size, ( size_t ) sysconf( _SC_PAGESIZE ) );
+        }
+
+        return ptr == MAP_FAILED ? NULL : ptr;
+    }
+
+#if defined(MAP_HUGETLB)
+    ptr = mmap( NULL, *size, PROT_READ | PROT_WRITE,
+                mflags | populate | MAP_HUGETLB, -1, 0 );
+
+    if( ptr != MAP_FAILED ) {
+        return ptr;
+    }
+
+#endif
+    /*
+     * Transparent huge pages: region is aligned to huge page (extra head and
+     * tail are unmapped), pages are faulted after the hint only:
+     */
+    map = mmap( NULL, *size + MP_HUGE_PAGE, PROT_READ | PROT_WRITE, mflags, -1,
+                0 );
+
+    if( map == MAP_FAILED ) {
+        return NULL;
+    }
+
+    ptr = ( char * )( ( ( size_t ) map + MP_HUGE_PAGE - 1 ) &
+                      ~( size_t )( MP_HUGE_PAGE - 1 ) );
+
+    if( ptr != map ) {
+        munmap( map, ptr - map );
+    }
+
+    munmap( ptr + *size, map + MP_HUGE_PAGE - ptr );
+#if defined(MADV_HUGEPAGE)
+    madvise( ptr, *size, MADV_HUGEPAGE );
+#endif
+
+    if( flags & MPF_POPULATE ) {
+        _mp_prefault( ptr, *size, ( size_t ) sysconf( _SC_PAGESIZE ) );
+    }
+
+    return ptr;
+}
+
+#endif
+
+/*
+ * Internal. Zero pool memory: mapped pages are dropped (they are zeroed
+ * when used again), pre-faulted and allocated memory is cleared.
+ */
+static void _mp_zero( const mpool mp )
+{
+#if defined(MP_MMAP)
+
+    if( mp->map_size && !( mp->flags & MPF_POPULATE ) &&
+            !madvise( mp->pool, mp->map_size, MADV_DONTNEED ) ) {
+        return;
+    }
+
+#endif
+    memset( mp->pool, 0, mp->size );
+}
+
+/*
+ * Internal. Return pages of completely free mapped pool to the system.
+ * Block header, free list links and boundary tag stay. Return released
+ * bytes. Call with lock held.
+ */
+static size_t _mp_release_pool( const mpool mp )
+{
+#if defined(MP_MMAP)
+    mblk mb = ( mblk ) mp->pool;
+    size_t page = ( mp->flags & MPF_HUGE ) ? MP_HUGE_PAGE :
+                  ( size_t ) sysconf( _SC_PAGESIZE );
+    size_t from, to;
+
+    if( !mp->map_size || ( mb->flags & MBF_BUSY ) || mb->size != mp->size ) {
+        return 0;
+    }
+
+    from = ( ( size_t )( mb + 1 ) + MB_FREE_MIN + page - 1 ) & ~( page - 1 );
+    to = ( ( size_t )( mb + 1 ) + mb->size ) & ~( page - 1 );
+
+    if( to <= from || madvise( ( char * ) from, to - from, MADV_DONTNEED ) ) {
+        return 0;
+    }
+
+    return to - from;
+#else
+    unused( mp );
+    return 0;
+#endif
+}
+
+/*
+ * Internal. Separate pool memory, mapped (MPF_MMAP) or allocated. 'size'
+ * can be increased to use the whole mapping.
+ */
+static char *_mp_pool_memory( const mpool mp, size_t *size, mp_flags flags )
+{
+    mp->map_size = 0;
+#if defined(MP_MMAP)
+
+    if( flags & MPF_MMAP ) {
+        char *pool;
+        mp->map_size = *size + MB_OVERHEAD;
+        pool = _mp_map( &mp->map_size, flags );
+
+        if( pool ) {
+            *size = ( mp->map_size - MB_OVERHEAD ) & ~( sizeof( size_t ) - 1 );
+        }
+
+        return pool;
+    }
+
+#else
+    unused( flags );
+#endif
+    return _mp_malloc( *size + MB_OVERHEAD );
+}
+
+/*
+ * Internal. Free pool memory and pool itself.
+ */
+static void _mp_free_pool( mpool mp )
+{
+#if defined(MP_MMAP)
+
+    if( mp->map_size ) {
+        munmap( mp->pool, mp->map_size );
+    }
+
+#endif
+
+    if( ( mp->flags & ( MPF_EXPAND | MPF_MMAP ) ) == MPF_EXPAND ) {
+        free( mp->pool );
+    }
+
+    free( mp->bins );
+    free( mp );
+}
+
+/*
+ * Internal. Create mpool without registration (used for chain pools too).
+ */
+static mpool _mp_create( size_t size, mp_flags flags )
+{
+    mpool mp;
+    size = ( size ? size : MPOOL_MIN );
+    MS_ALIGN( size, MPOOL_MIN );
+
+    if( flags & ( MPF_HUGE | MPF_POPULATE ) ) {
+        flags |= MPF_MMAP;
+    }
+
+#if !defined(MP_MMAP)
+    flags &= ~( MPF_MMAP | MPF_HUGE | MPF_POPULATE );
+#endif
+
+    if( !( flags & ( MPF_EXPAND | MPF_MMAP ) ) ) {
+        mp = _mp_malloc( sizeof( struct _mpool ) + size + MB_OVERHEAD );
+
+        if( !mp ) {
+            return NULL;
+        }
+
+        mp->pool = ( char * )( mp + 1 );
+        mp->map_size = 0;
+    }
+    else {
+        mp = _mp_malloc( sizeof( struct _mpool ) );
+
+        if( !mp ) {
+            return NULL;
+        }
+
+        mp->pool = _mp_pool_memory( mp, &size, flags );
+
+        if( !mp->pool ) {
+            free( mp );
+            return NULL;
+        }
+    }
+
+    mp->flags = flags;
+    mp->bins = NULL;
+
+    if( flags & MPF_BINS ) {
+        mp->bins = _mp_malloc( sizeof( struct _mp_bins ) );
+
+        if( !mp->bins ) {
+            _mp_free_pool( mp );
+            return NULL;
+        }
+    }
+
+    __initlock( mp->lock );
+    mp->id = 0;
+    mp->size = size;
+    mp->next = NULL;
+    mp->tc_next = NULL;
+    mp->min = mp->pool + sizeof( struct _mblk );
+    mp->max = mp->pool + size + sizeof( struct _mblk ) - MBLK_MIN;
+    mp->last = ( struct _mblk * ) mp->pool;
+    mp_clear( mp );
+    return mp;
+}
+
+static void _mp_free_chain( mpool mp )
+{
+    while( mp ) {
+        mpool next = mp->next;
+        _mp_free_pool( mp );
+        mp = next;
+    }
+}
+
+/* ---------------------------------------------------------------------------*/
+
+#if defined(MP_TCACHE)
+
+/*
+ * Thread caches. Every thread keeps free blocks of up to MP_TCACHE_POOLS
+ * pools with MPF_TCACHE flag in size class bins (intrusive lists, next
+ * pointer is stored in block memory). Cached blocks stay busy for the pool.
+ * Bins are refilled from the pool and spilled back by MP_TCACHE_BATCH
+ * blocks under one pool lock. Cache is tied to pool generation: mp_clear()
+ * drops all cached blocks. Pools with caches are registered, so caches of
+ * destroyed pools are not flushed on thread exit.
+ */
+#define MP_TC_CLASS_SIZE(c)     (((c) + 1) * MP_TCACHE_ALIGN)
+#define MP_TC_CLASSES           (MP_TCACHE_MAX / MP_TCACHE_ALIGN)
+
+typedef struct _mp_tcache {
+    mpool mp;
+    size_t gen;
+    void *bins[MP_TC_CLASSES];
+    unsigned int count[MP_TC_CLASSES];
+} mp_tcache;
+
+static __thread mp_tcache _mp_tc[MP_TCACHE_POOLS];
+static __thread unsigned int _mp_tc_evict;
+static pthread_mutex_t _mp_tc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t _mp_tc_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _mp_tc_key;
+static mpool _mp_tc_pools = NULL;
+
+static inline void *_mp_tc_next( void *ptr )
+{
+    void *next;
+    memcpy( &next, ptr, sizeof( void * ) );
+    return next;
+}
+
+static inline void _mp_tc_push( mp_tcache *tc, size_t c, void *ptr )
+{
+    memcpy( ptr, &tc->bins[c], sizeof( void * ) );
+    tc->bins[c] = ptr;
+    tc->count[c]++;
+}
+
+static inline void *_mp_tc_pop( mp_tcache *tc, size_t c )
+{
+    void *ptr = tc->bins[c];
+
+    if( ptr ) {
+        tc->bins[c] = _mp_tc_next( ptr );
+        tc->count[c]--;
     }
 
     return ptr;
 }
 
-static int MP_VALID( void *ptr, mpool mp )
+static void _mp_tc_register( mpool mp )
 {
-    if( ( char * )( ptr ) < mp->min || ( char * )( ptr ) > mp->max ) {
-        return 0;
+    pthread_mutex_lock( &_mp_tc_lock );
+    mp->tc_next = _mp_tc_pools;
+    _mp_tc_pools = mp;
+    pthread_mutex_unlock( &_mp_tc_lock );
+}
+
+static void _mp_tc_unregister( mpool mp )
+{
+    mpool *pp;
+    unsigned int i;
+    pthread_mutex_lock( &_mp_tc_lock );
+
+    for( pp = &_mp_tc_pools; *pp; pp = &( *pp )->tc_next ) {
+        if( *pp == mp ) {
+            *pp = mp->tc_next;
+            break;
+        }
     }
 
-    return ( ( ( ( struct _mblk * )( ptr ) ) - 1 )->signature == MBLK_SIGNATURE );
+    pthread_mutex_unlock( &_mp_tc_lock );
+
+    for( i = 0; i < MP_TCACHE_POOLS; i++ ) {
+        if( _mp_tc[i].mp == mp ) {
+            memset( &_mp_tc[i], 0, sizeof( mp_tcache ) );
+        }
+    }
 }
 
-static int MB_VALID( mblk mb, mpool mp )
+static void _mp_free_block( const mpool mp, void *ptr );
+
+/*
+ * Internal. Return all cached blocks to their pool if it is still alive.
+ */
+static void _mp_tc_flush( mp_tcache *tc )
 {
-    if( ( char * )( mb + 1 ) < mp->min || ( char * )( mb + 1 ) > mp->max ) {
-        return 0;
+    mpool mp;
+    size_t c;
+    pthread_mutex_lock( &_mp_tc_lock );
+
+    for( mp = _mp_tc_pools; mp && mp != tc->mp; mp = mp->tc_next ) {
     }
 
-    return ( mb->signature == MBLK_SIGNATURE );
+    if( mp && mp->gen == tc->gen ) {
+        __lock( mp->lock );
+
+        for( c = 0; c < MP_TC_CLASSES; c++ ) {
+            void *ptr;
+
+            while( ( ptr = _mp_tc_pop( tc, c ) ) != NULL ) {
+                _mp_free_block( mp, ptr );
+            }
+        }
+
+        __unlock( mp->lock );
+    }
+
+    pthread_mutex_unlock( &_mp_tc_lock );
+    memset( tc, 0, sizeof( mp_tcache ) );
 }
 
-static mblk MB_NEXT( mblk mb )
+static void _mp_tc_exit( void *data )
 {
-    return ( mblk )( ( char * )( mb ) + sizeof( struct _mblk ) + mb->size );
+    unsigned int i;
+    unused( data );
+
+    for( i = 0; i < MP_TCACHE_POOLS; i++ ) {
+        if( _mp_tc[i].mp ) {
+            _mp_tc_flush( &_mp_tc[i] );
+        }
+    }
 }
 
-#else
+static void _mp_tc_key_create( void )
+{
+    pthread_key_create( &_mp_tc_key, _mp_tc_exit );
+}
 
-#define MP_VALID(ptr, mp) \
-    ((char *)(ptr) >= (mp)->min && \
-    (char *)(ptr) <= (mp)->max && \
-    (((struct _mblk *)(ptr)) - 1)->signature == MBLK_SIGNATURE)
+/*
+ * Internal. Get current thread cache of pool.
+ */
+static mp_tcache *_mp_tc_get( const mpool mp )
+{
+    mp_tcache *tc = NULL;
+    unsigned int i;
 
-#define MB_VALID(mb, mp) \
-    ((char *)((mb)+1) >= (mp)->min && \
-    (char *)((mb)+1) <= (mp)->max && \
-    (mb)->signature == MBLK_SIGNATURE)
+    for( i = 0; i < MP_TCACHE_POOLS; i++ ) {
+        if( _mp_tc[i].mp == mp ) {
+            tc = &_mp_tc[i];
 
-#define MB_NEXT(mb) \
-        (mblk)((char *)(mb) + sizeof(struct _mblk) + (mb)->size)
+            if( tc->gen != mp->gen ) {
+                memset( tc, 0, sizeof( mp_tcache ) );
+                tc->mp = mp;
+                tc->gen = mp->gen;
+            }
 
-#define _mp_malloc(size) malloc( (size) )
+            return tc;
+        }
 
-#endif
+        if( !tc && !_mp_tc[i].mp ) {
+            tc = &_mp_tc[i];
+        }
+    }
 
-#define MS_ALIGN(size, min) \
-    if( (size) < (min) ) (size) = (min); \
-    (size) += (sizeof(size_t) - 1); \
-    (size) &= ~(sizeof(size_t) - 1)
+    if( !tc ) {
+        tc = &_mp_tc[_mp_tc_evict++ % MP_TCACHE_POOLS];
+        _mp_tc_flush( tc );
+    }
+    else {
+        /*
+         * Free slot must be empty, but never take blocks of another pool:
+         */
+        memset( tc, 0, sizeof( mp_tcache ) );
+    }
 
-#define MP_SWAP(tmp, a, b) \
-    (tmp) = (a); \
-    (a) = (b); \
-    (b) = (tmp)
+    /*
+     * Any non-NULL value, key destructor flushes caches on thread exit:
+     */
+    pthread_once( &_mp_tc_once, _mp_tc_key_create );
+    pthread_setspecific( _mp_tc_key, _mp_tc );
+    tc->mp = mp;
+    tc->gen = mp->gen;
+    return tc;
+}
 
-static mpool _mp = NULL;
-static int _mp_atexit = 0;
+static void *_mp_alloc_chain( const mpool mp, size_t size );
 
-static void _mp_destroy( void )
+/*
+ * Internal. Allocate from cache, refill empty bin. 'size' is aligned.
+ */
+static void *_mp_tc_alloc( const mpool mp, size_t size )
 {
-    mp_destroy( _mp );
-}
+    size_t c = ( size - 1 ) / MP_TCACHE_ALIGN;
+    mp_tcache *tc = _mp_tc_get( mp );
+    void *ptr = _mp_tc_pop( tc, c );
+    unsigned int i;
 
-#define MP_SET(mp) \
-    if( !mp ) { \
-    if( !_mp ) _mp = mp_create( 0, MPF_EXPAND ); \
-    mp = _mp; }
+    if( ptr ) {
+        return ptr;
+    }
+
+    __lock( mp->lock );
+
+    for( i = 0; i < MP_TCACHE_BATCH; i++ ) {
+        ptr = _mp_alloc_chain( mp, MP_TC_CLASS_SIZE( c ) );
+
+        if( !ptr ) {
+            break;
+        }
+
+        _mp_tc_push( tc, c, ptr );
+    }
+
+    __unlock( mp->lock );
+    return _mp_tc_pop( tc, c );
+}
 
 /*
- * Recursive check for all mpools in chain:
+ * Internal. Put block to cache, spill full bin. Return 1 (cached), 0 (not
+ * valid or locked pointer) or -1 (can not be cached).
  */
-static int _mp_valid_ptr( void *ptr, const mpool mp )
+static int _mp_tc_free( const mpool mp, void *ptr )
 {
-    if( !mp || !ptr ) {
+    mblk mb = ( ( struct _mblk * ) ptr ) - 1;
+    mp_tcache *tc;
+    size_t c;
+    unsigned int i;
+
+    if( !_mp_valid_ptr( ptr, mp ) || ( mb->flags & MBF_LOCKED ) ) {
         return 0;
     }
 
-    return MP_VALID( ptr, mp ) ? 1 : _mp_valid_ptr( ptr, mp->next );
-}
+    if( !( mb->flags & MBF_BUSY ) || mb->size < MP_TCACHE_ALIGN ||
+            mb->size > MP_TCACHE_MAX ) {
+        return -1;
+    }
 
-mpool mp_create( size_t size, mp_flags flags )
-{
-    mpool mp;
-    size = ( size ? size : MPOOL_MIN );
-    MS_ALIGN( size, MPOOL_MIN );
+    c = mb->size / MP_TCACHE_ALIGN - 1;
+    tc = _mp_tc_get( mp );
 
-    if( ( flags & MPF_EXPAND ) != MPF_EXPAND ) {
-        mp = _mp_malloc( sizeof( struct _mpool ) + size + sizeof( struct _mblk ) );
+    if( tc->count[c] >= MP_TCACHE_COUNT ) {
+        __lock( mp->lock );
 
-        if( !mp ) {
-            return NULL;
+        for( i = 0; i < MP_TCACHE_BATCH; i++ ) {
+            _mp_free_block( mp, _mp_tc_pop( tc, c ) );
         }
 
-        mp->pool = ( char * )( mp + 1 );
+        __unlock( mp->lock );
     }
-    else {
-        mp = _mp_malloc( sizeof( struct _mpool ) );
 
-        if( !mp ) {
-            return NULL;
-        }
+    _mp_tc_push( tc, c, ptr );
+    return 1;
+}
 
-        mp->pool = _mp_malloc( size + sizeof( struct _mblk ) );
+#endif
 
-        if( !mp->pool ) {
-            free( mp );
-            return NULL;
-        }
+/* ---------------------------------------------------------------------------*/
+
+mpool mp_create( size_t size, mp_flags flags )
+{
+    mpool mp = _mp_create( size, flags );
+
+    if( !mp ) {
+        return NULL;
     }
 
-    if( !_mp_atexit ) {
-        _mp_atexit = 1;
+    if( !__atomic_exchange_n( &_mp_atexit, 1, __ATOMIC_ACQ_REL ) ) {
         atexit( _mp_destroy );
     }
 
-    __initlock( mp->lock );
-    mp->id = 0;
-    mp->size = size;
-    mp->next = NULL;
-    mp->flags = flags;
-    mp->min = mp->pool + sizeof( struct _mblk );
-    mp->max = mp->pool + size - MBLK_MIN;
-    mp->last = ( struct _mblk * ) mp->pool;
-    mp_clear( mp );
+#if defined(MP_TCACHE)
+
+    if( flags & MPF_TCACHE ) {
+        _mp_tc_register( mp );
+    }
+
+#endif
     return mp;
 }
 
@@ -170,25 +970,45 @@ void mp_clear( mpool mp )
         mp_clear( mp->next );
     }
 
-    memset( ( ( mblk ) mp->pool ), 0, mp->size );
+    mp->gen = __atomic_add_fetch( &_mp_gen, 1, __ATOMIC_RELAXED );
+    _mp_zero( mp );
     ( ( mblk ) mp->pool )->flags = 0;
     ( ( mblk ) mp->pool )->size = mp->size;
     ( ( mblk ) mp->pool )->signature = MBLK_SIGNATURE;
+    _mb_set_tag( ( mblk ) mp->pool, 1 );
+
+    if( mp->bins ) {
+        memset( mp->bins, 0, sizeof( struct _mp_bins ) );
+        _mp_bins_insert( mp->bins, ( mblk ) mp->pool );
+    }
+}
+
+size_t mp_release( mpool mp )
+{
+    mpool current;
+    size_t released = 0;
+    MP_SET( mp );
+    __lock( mp->lock );
+
+    for( current = mp; current; current = current->next ) {
+        released += _mp_release_pool( current );
+    }
+
+    __unlock( mp->lock );
+    return released;
 }
 
 void mp_destroy( mpool mp )
 {
     if( mp ) {
-        /*mp_clear( mp );*/
-        if( ( mp->flags & MPF_EXPAND ) == MPF_EXPAND ) {
-            free( mp->pool );
-        }
+#if defined(MP_TCACHE)
 
-        if( mp->next ) {
-            mp_destroy( mp->next );
+        if( mp->flags & MPF_TCACHE ) {
+            _mp_tc_unregister( mp );
         }
 
-        free( mp );
+#endif
+        _mp_free_chain( mp );
     }
 }
 
@@ -237,45 +1057,6 @@ void mp_walk( mpool mp, mp_walker walker, void *data )
     }
 }
 
-/*
- * Internal. Defragment mpool. Return free blocks junction count.
- */
-static size_t _mp_defragment_pool( const mpool mp )
-{
-    mblk mb;
-    mblk next;
-    size_t junctions;
-
-    if( !mp || ( mp->flags & MPF_DIRTY ) != MPF_DIRTY ) {
-        return 0;
-    }
-
-    junctions = 0;
-    mb = ( mblk ) mp->pool;
-
-    while( MB_VALID( mb, mp ) ) {
-        next = MB_NEXT( mb );
-
-        if( !MB_VALID( next, mp ) ) {
-            break;
-        }
-
-        if( ( mb->flags & MBF_BUSY ) || ( next->flags & MBF_BUSY ) ) {
-            mb = next;
-            continue;
-        }
-
-        mb->size += next->size + sizeof( struct _mblk );
-        junctions++;
-    }
-
-    if( junctions ) {
-        mp->flags &= ( ~MPF_DIRTY );
-    }
-
-    return junctions;
-}
-
 /*
  * Internal. Try to allocate requested block.
  */
@@ -311,82 +1092,157 @@ static void *_mp_alloc( const mpool mp, size_t size )
         }
     }
 
-    if( best ) {
-        if( best->size > size + MBLK_MIN + sizeof( struct _mblk ) ) {
-            /* split block */
-            mb = ( mblk )( ( char * ) best + sizeof( struct _mblk ) + size );
-            mb->signature = MBLK_SIGNATURE;
-            mb->flags = 0;
-            mb->size = best->size - size - sizeof( struct _mblk );
-            mp->last = mb;
-            best->size = size;
+    return best ? _mp_use_block( mp, best, size ) : NULL;
+}
+
+/*
+ * Internal. Try pool. Free blocks are merged in mp_free(), so there is
+ * nothing to defragment.
+ */
+static void *_mp_alloc_pool( const mpool current, size_t size )
+{
+    return current->bins ? _mp_bins_alloc( current, size ) :
+           _mp_alloc( current, size );
+}
+
+/*
+ * Internal. Allocate from pools chain, expand it if needed. Expansion
+ * pools are linked right after the head, so the chain is searched from the
+ * newest (largest) pool, the head is the last one. Call with lock held.
+ */
+static void *_mp_alloc_chain( const mpool mp, size_t size )
+{
+    void *ptr = NULL;
+    mpool current;
+    mpool newpool;
+    size_t largest_pool_size = mp->size;
+    size_t npools = 1;
+
+    for( current = mp->next; current && !ptr; current = current->next ) {
+        npools++;
+        ptr = _mp_alloc_pool( current, size );
+
+        if( largest_pool_size < current->size ) {
+            largest_pool_size = current->size;
         }
+    }
+
+    if( !ptr ) {
+        ptr = _mp_alloc_pool( mp, size );
+    }
+
+    if( ptr || ( mp->flags & MPF_EXPAND ) != MPF_EXPAND ) {
+        return ptr;
+    }
+
+    newpool = _mp_create( MP_EXPAND_FOR( ( largest_pool_size + size ) ),
+                          mp->flags );
 
-        best->flags = MBF_BUSY;
-        mp->flags |= MPF_DIRTY;
-        return best + 1;
+    if( !newpool ) {
+        return NULL;
     }
 
-    return NULL;
+    newpool->id = npools;
+    newpool->next = mp->next;
+    __atomic_store_n( &mp->next, newpool, __ATOMIC_RELEASE );
+    return _mp_alloc_pool( newpool, size );
 }
 
 void *mp_alloc( mpool mp, size_t size )
 {
     void *ptr;
-    mpool current_pool;
-    size_t largest_pool_size;
-    size_t workhorse;
     MP_SET( mp );
-    __lock( mp->lock );
-    largest_pool_size = mp->size;
-    workhorse = 0;
     MS_ALIGN( size, MBLK_MIN );
-    current_pool = mp;
+#if defined(MP_TCACHE)
 
-    do {
-        workhorse++;
-        ptr = _mp_alloc( current_pool, size );
+    if( ( mp->flags & MPF_TCACHE ) && size <= MP_TCACHE_MAX ) {
+        return _mp_tc_alloc( mp, size );
+    }
 
-        if( !ptr ) {
-            if( ( !( mp->flags & MPF_FAST ) &&
-                    _mp_defragment_pool( current_pool ) ) ) {
-                ptr = _mp_alloc( current_pool, size );
-            }
-        }
+#endif
+    __lock( mp->lock );
+    ptr = _mp_alloc_chain( mp, size );
+    __unlock( mp->lock );
+    return ptr;
+}
+
+/*
+ * Internal. Cut aligned block of 'size' bytes from busy block 'ptr', free
+ * head and tail around it. Call with lock held.
+ */
+static void *_mp_align_block( const mpool mp, void *ptr, size_t size,
+                              size_t align )
+{
+    mpool current = mp;
+    mblk mb = ( ( struct _mblk * ) ptr ) - 1;
+    char *aligned = ( char * )( ( ( size_t ) ptr + align - 1 ) & ~( align - 1 ) );
 
-        current_pool = current_pool->next;
+    while( current && !MP_VALID( ptr, current ) ) {
+        current = current->next;
     }
-    while( !ptr && current_pool );
 
-    if( !ptr && ( mp->flags & MPF_EXPAND ) == MPF_EXPAND ) {
-        mpool newpool = mp_create( MP_EXPAND_FOR( ( largest_pool_size + size ) ),
-                                   mp->flags );
+    /*
+     * Head must be large enough for free block:
+     */
+    while( aligned != ptr &&
+            ( size_t )( aligned - ( char * ) ptr ) < MB_OVERHEAD + MB_FREE_MIN ) {
+        aligned += align;
+    }
 
-        if( !newpool ) {
-            __unlock( mp->lock );
-            return NULL;
-        }
+    if( aligned != ptr ) {
+        mblk amb = ( ( struct _mblk * ) aligned ) - 1;
+        amb->signature = MBLK_SIGNATURE;
+        amb->flags = MBF_BUSY;
+        amb->size = mb->size - ( aligned - ( char * ) ptr );
+        mb->size = aligned - ( char * ) ptr - MB_OVERHEAD;
+        _mb_set_tag( amb, 0 );
+        _mb_set_tag( mb, 0 );
+        _mp_free_mb( current, mb );
+        mb = amb;
+    }
 
-        if( mp->next ) {
-            newpool->next = mp->next;
-        }
+    if( mb->size >= size + MB_OVERHEAD + MB_FREE_MIN ) {
+        mblk tail = ( mblk )( ( char * ) mb + MB_OVERHEAD + size );
+        tail->signature = MBLK_SIGNATURE;
+        tail->flags = MBF_BUSY;
+        tail->size = mb->size - size - MB_OVERHEAD;
+        mb->size = size;
+        _mb_set_tag( tail, 0 );
+        _mb_set_tag( mb, 0 );
+        _mp_free_mb( current, tail );
+    }
 
-        mp->next = newpool;
+    return mb + 1;
+}
 
-        if( mp->flags & MPF_FAST ) {
-            _mp_defragment_pool( mp );
-        }
+void *mp_alloc_aligned( mpool mp, size_t size, size_t align )
+{
+    void *ptr;
+    MP_SET( mp );
 
-        /*
-         * swap base pool and newpool (set new pool first)
-         */
-        newpool->id = mp->id;
-        mp->id = workhorse;
-        MP_SWAP( workhorse, mp->size, newpool->size );
-        MP_SWAP( ptr, mp->min, newpool->min );
-        MP_SWAP( ptr, mp->max, newpool->max );
-        MP_SWAP( ptr, mp->pool, newpool->pool );
-        ptr = _mp_alloc( mp, size );
+    if( !align || ( align & ( align - 1 ) ) ) {
+        return NULL;
+    }
+
+    /*
+     * Block sizes are even (boundary tag free bit), so head and tail sizes
+     * must be too:
+     */
+    if( align < sizeof( size_t ) ) {
+        align = sizeof( size_t );
+    }
+
+    MS_ALIGN( size, MBLK_MIN );
+
+    if( size > ( size_t ) - 1 - align - MB_OVERHEAD - MB_FREE_MIN ) {
+        return NULL;
+    }
+
+    __lock( mp->lock );
+    ptr = _mp_alloc_chain( mp, size + align + MB_OVERHEAD + MB_FREE_MIN );
+
+    if( ptr ) {
+        ptr = _mp_align_block( mp, ptr, size, align );
     }
 
     __unlock( mp->lock );
@@ -434,6 +1290,10 @@ void *mp_realloc( mpool mp, void *src, size_t size )
     MP_SET( mp );
     dest = NULL;
 
+    if( !src ) {
+        return mp_alloc( mp, size );
+    }
+
     if( _mp_valid_ptr( src, mp ) ) {
         if( !( ( ( ( struct _mblk * ) src ) - 1 )->flags & MBF_LOCKED ) ) {
             dest = mp_alloc( mp, size );
@@ -450,8 +1310,6 @@ void *mp_realloc( mpool mp, void *src, size_t size )
         }
     }
 
-    __unlock( mp->lock );
-
     if( dest ) {
         mp_free( mp, src );
     }
@@ -459,42 +1317,51 @@ void *mp_realloc( mpool mp, void *src, size_t size )
     return dest;
 }
 
+/*
+ * Internal. Mark block free in pool it belongs to. Call with lock held.
+ */
+static void _mp_free_block( const mpool mp, void *ptr )
+{
+    mpool current = mp;
+
+    while( current && !MP_VALID( ptr, current ) ) {
+        current = current->next;
+    }
+
+    if( current && ( ( ( ( struct _mblk * ) ptr ) - 1 )->flags & MBF_BUSY ) ) {
+        _mp_free_mb( current, ( ( struct _mblk * ) ptr ) - 1 );
+    }
+}
+
 int mp_free( mpool mp, void *ptr )
 {
-    mpool locked;
     MP_SET( mp );
-    __lock( mp->lock );
-    locked = mp;
 
     if( !ptr ) {
-        __unlock( locked->lock );
         return 0;
     }
 
-    while( mp ) {
-        if( !MP_VALID( ptr, mp ) ) {
-            break;
-        }
+#if defined(MP_TCACHE)
 
-        mp = mp->next;
-    }
+    if( mp->flags & MPF_TCACHE ) {
+        int rc = _mp_tc_free( mp, ptr );
 
-    if( !mp ) {
-        __unlock( locked->lock );
-        return 0;
+        if( rc >= 0 ) {
+            return rc;
+        }
     }
 
-    if( ( ( ( struct _mblk * ) ptr ) - 1 )->flags & MBF_LOCKED ) {
-        __unlock( locked->lock );
-        return 0;
-    }
+#endif
+    __lock( mp->lock );
 
-    if( ( ( ( struct _mblk * ) ptr ) - 1 )->flags & MBF_BUSY ) {
-        mp->flags |= MPF_DIRTY;
+    if( !_mp_valid_ptr( ptr, mp ) ||
+            ( ( ( ( struct _mblk * ) ptr ) - 1 )->flags & MBF_LOCKED ) ) {
+        __unlock( mp->lock );
+        return 0;
     }
 
-    ( ( ( struct _mblk * ) ptr ) - 1 )->flags = 0;
-    __unlock( locked->lock );
+    _mp_free_block( mp, ptr );
+    __unlock( mp->lock );
     return 1;
 }
 
@@ -581,12 +1448,12 @@ void mp_dump( mpool mp, FILE *fout, size_t maxw )
         fprintf( fout, "ID: %zu, size: %s, ", current->id,
                  _mp_format_size( current->size, bsz ) );
         fprintf( fout, "blocks: %zu, internal: %s\n", mb_total,
-                 _mp_format_size( mb_total * sizeof( struct _mblk ), bsz ) );
+                 _mp_format_size( mb_total * MB_OVERHEAD, bsz ) );
 #else
         fprintf( fout, "ID: %u, size: %s, ", current->id,
                  _mp_format_size( current->size, bsz ) );
         fprintf( fout, "blocks: %u, internal: %s\n", mb_total,
-                 _mp_format_size( mb_total * sizeof( struct _mblk ) ), bsz );
+                 _mp_format_size( mb_total * MB_OVERHEAD ), bsz );
 #endif
         mb = ( mblk ) current->pool;
 
@@ -651,7 +1518,7 @@ void mp_dump( mpool mp, FILE *fout, size_t maxw )
              _mp_format_size( mp_largest_free, bsz ) );
     fprintf( fout, "%-16s: %s\n", "Internal memory",
              _mp_format_size(
-                 ( mp_blocks * sizeof( struct _mblk ) )
+                 ( mp_blocks * MB_OVERHEAD )
                  + ( mp_pools * sizeof( struct _mpool ) ), bsz ) );
     free( outbuf );
 }
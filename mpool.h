@@ -27,12 +27,35 @@ extern "C"
 # define MPOOL_MIN      (1024*1024*16)
 #endif
 
+/*
+ * MPF_MMAP pools memory is mapped with mmap() (malloc() is used on
+ * Windows). MPF_HUGE tries MAP_HUGETLB first (huge pages must be reserved),
+ * then maps region aligned to MP_HUGE_PAGE with MADV_HUGEPAGE hint
+ * (transparent huge pages), pool size is rounded up to MP_HUGE_PAGE.
+ * MPF_POPULATE pre-faults all pool pages at creation. MPF_HUGE and
+ * MPF_POPULATE set MPF_MMAP.
+ */
+#define MP_HUGE_PAGE    (1024*1024*2)
+
 /*
  * If mp_alloc() failed, new mpool will be added to chain with new
  * size = ([old mpool size] + [requested size]) * MP_EXPAND_FOR
  */
 #define MP_EXPAND_FOR(sz)   ((sz) + ((sz) / 2))
 
+/*
+ * Thread caches (MPF_TCACHE, USE_LOCKING only): blocks up to MP_TCACHE_MAX
+ * bytes are kept in per-thread size class bins (MP_TCACHE_ALIGN bytes
+ * step), up to MP_TCACHE_COUNT blocks per bin, and are moved from / to the
+ * pool by MP_TCACHE_BATCH blocks. Every thread has caches for up to
+ * MP_TCACHE_POOLS pools. Cached blocks are busy for mp_walk() / mp_dump().
+ */
+#define MP_TCACHE_ALIGN     16
+#define MP_TCACHE_MAX       512
+#define MP_TCACHE_COUNT     64
+#define MP_TCACHE_BATCH     16
+#define MP_TCACHE_POOLS     4
+
 #pragma pack(1)
 
 typedef enum _mb_flags
@@ -49,13 +72,24 @@ typedef struct _mblk {
     size_t size;
 } *mblk;
 
+/*
+ * Only block headers are packed: pool fields are read and written with
+ * atomic operations.
+ */
+#pragma pack()
+
 /*
  * Warning! Do not change flags manually after mp_create() call!
  */
 typedef enum _mp_flags {
-    MPF_DIRTY = 0x01,        /* internal defrag flag */
+    MPF_DIRTY = 0x01,        /* not used, free blocks are merged at once */
     MPF_EXPAND = 0x02,       /* expand mpool memory if needed */
     MPF_FAST = 0x04,         /* do not search best free block, etc */
+    MPF_TCACHE = 0x08,       /* thread caches, set for default mpool */
+    MPF_BINS = 0x10,         /* segregated free lists, O(1) alloc / free */
+    MPF_MMAP = 0x20,         /* anonymous mmap() memory, see mp_release() */
+    MPF_HUGE = 0x40,         /* MPF_MMAP, huge pages or THP hint */
+    MPF_POPULATE = 0x80,     /* MPF_MMAP, pre-fault all pages */
     MPF_DEFAULT = ( 0x00 )
 } mp_flags;
 
@@ -69,6 +103,10 @@ typedef struct _mpool {
     char *max;
     char *pool;
     struct _mpool *next;
+    size_t gen;
+    struct _mpool *tc_next;
+    struct _mp_bins *bins;
+    size_t map_size;            /* MPF_MMAP: mapped bytes */
 } *mpool;
 
 typedef void ( *mp_walker )( const mpool mp, const mblk mb, void *data );
@@ -78,6 +116,12 @@ void mp_clear( mpool mp );
 void mp_destroy( mpool mp );
 
 void mp_clear( mpool mp );
+/*
+ * Return memory of completely free MPF_MMAP pools (expansion segments and
+ * the head one) to the system with madvise(MADV_DONTNEED). Pools stay in
+ * chain, pages are mapped again when used. Return size of released ranges.
+ */
+size_t mp_release( mpool mp );
 #define m_release()             mp_release( NULL )
 
 void *mp_alloc( mpool mp, size_t size );
@@ -88,6 +132,12 @@ void *mp_realloc( mpool mp, void *src, size_t size );
 #define m_calloc(size, n)       mp_calloc( NULL, (size), (n) )
 #define m_strdup(src)           mp_strdup( NULL, (src) )
 #define m_realloc(src, size)    mp_realloc( NULL, (src), (size) )
+/*
+ * 'align' is power of 2 (cache line, SIMD vector, page etc). Block is freed
+ * with mp_free(), mp_realloc() result is not aligned:
+ */
+void *mp_alloc_aligned( mpool mp, size_t size, size_t align );
+#define m_alloc_aligned(size, align) mp_alloc_aligned( NULL, (size), (align) )
 
 int mp_lock( mpool mp, void *ptr );
 int mp_locked( mpool mp, void *ptr );
@@ -104,8 +154,6 @@ void mp_dump( mpool, FILE *, size_t );
 #define m_walk(walker, data)    mp_walk( NULL, (walker), (data) )
 #define m_dump(file, width)     mp_dump( NULL, (file), (width) )
 
-#pragma pack()
-
 #if defined(__cplusplus)
 }
 #endif
@@ -24,13 +24,28 @@ static const unsigned int sha256_k[64] = {
     0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
-static void _transform( SHA256 *sha256, const unsigned char *message,
-                        unsigned int block_nb ) {
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+# define SHA256_X86
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+# define SHA256_ARM
+# include <arm_neon.h>
+#endif
+
+/*
+ * Block functions process 'block_nb' 64-byte blocks, state is m_h[]
+ */
+typedef void ( *_sha256_blocks_f )( unsigned int *h,
+                                    const unsigned char *message,
+                                    size_t block_nb );
+
+static void _sha256_blocks_c( unsigned int *h, const unsigned char *message,
+                              size_t block_nb ) {
     unsigned int w[64];
     unsigned int wv[8];
     unsigned int t1, t2;
     const unsigned char *sub_block;
-    unsigned int i;
+    size_t i;
     unsigned int j;
     for( i = 0; i < block_nb; i++ ) {
         sub_block = message + ( i << 6 );
@@ -42,7 +57,7 @@ static void _transform( SHA256 *sha256, const unsigned char *message,
                    + w[j - 16];
         }
         for( j = 0; j < 8; j++ ) {
-            wv[j] = sha256->m_h[j];
+            wv[j] = h[j];
         }
         for( j = 0; j < 64; j++ ) {
             t1 = wv[7] + SHA256_F2( wv[4] ) + SHA2_CH( wv[4], wv[5], wv[6] )
@@ -58,11 +73,283 @@ static void _transform( SHA256 *sha256, const unsigned char *message,
             wv[0] = t1 + t2;
         }
         for( j = 0; j < 8; j++ ) {
-            sha256->m_h[j] += wv[j];
+            h[j] += wv[j];
         }
     }
 }
 
+#if defined(SHA256_X86)
+
+/*
+ * SHA extensions (SHA-NI). State is kept as ABEF/CDGH pairs, every
+ * sha256rnds2 does 2 rounds. Four rounds group 'g' uses message words 'm0',
+ * completes schedule of the next group words 'm1' and starts schedule of
+ * 'm3' words for group g + 3.
+ */
+#define _SHA_NI_ROUNDS( g, m0, m1, m3 ) \
+    do { \
+        msg = _mm_add_epi32( m0, \
+                _mm_loadu_si128( ( const __m128i * ) &sha256_k[( g ) * 4] ) ); \
+        state1 = _mm_sha256rnds2_epu32( state1, state0, msg ); \
+        if( ( g ) >= 3 && ( g ) <= 14 ) { \
+            tmp = _mm_alignr_epi8( m0, m3, 4 ); \
+            m1 = _mm_sha256msg2_epu32( _mm_add_epi32( m1, tmp ), m0 ); \
+        } \
+        msg = _mm_shuffle_epi32( msg, 0x0E ); \
+        state0 = _mm_sha256rnds2_epu32( state0, state1, msg ); \
+        if( ( g ) >= 1 && ( g ) <= 12 ) { \
+            m3 = _mm_sha256msg1_epu32( m3, m0 ); \
+        } \
+    } while( 0 )
+
+__attribute__( ( target( "sha,ssse3,sse4.1" ) ) )
+static void _sha256_blocks_shani( unsigned int *h,
+                                  const unsigned char *message,
+                                  size_t block_nb ) {
+    const __m128i mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL );
+    __m128i state0, state1, msg, tmp, m0, m1, m2, m3, abef, cdgh;
+    tmp = _mm_loadu_si128( ( const __m128i * ) &h[0] );
+    state1 = _mm_loadu_si128( ( const __m128i * ) &h[4] );
+    tmp = _mm_shuffle_epi32( tmp, 0xB1 );
+    state1 = _mm_shuffle_epi32( state1, 0x1B );
+    state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1 = _mm_blend_epi16( state1, tmp, 0xF0 );
+    while( block_nb-- ) {
+        abef = state0;
+        cdgh = state1;
+        m0 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( message +
+                               0 ) ), mask );
+        m1 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( message +
+                               16 ) ), mask );
+        m2 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( message +
+                               32 ) ), mask );
+        m3 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( message +
+                               48 ) ), mask );
+        _SHA_NI_ROUNDS( 0, m0, m1, m3 );
+        _SHA_NI_ROUNDS( 1, m1, m2, m0 );
+        _SHA_NI_ROUNDS( 2, m2, m3, m1 );
+        _SHA_NI_ROUNDS( 3, m3, m0, m2 );
+        _SHA_NI_ROUNDS( 4, m0, m1, m3 );
+        _SHA_NI_ROUNDS( 5, m1, m2, m0 );
+        _SHA_NI_ROUNDS( 6, m2, m3, m1 );
+        _SHA_NI_ROUNDS( 7, m3, m0, m2 );
+        _SHA_NI_ROUNDS( 8, m0, m1, m3 );
+        _SHA_NI_ROUNDS( 9, m1, m2, m0 );
+        _SHA_NI_ROUNDS( 10, m2, m3, m1 );
+        _SHA_NI_ROUNDS( 11, m3, m0, m2 );
+        _SHA_NI_ROUNDS( 12, m0, m1, m3 );
+        _SHA_NI_ROUNDS( 13, m1, m2, m0 );
+        _SHA_NI_ROUNDS( 14, m2, m3, m1 );
+        _SHA_NI_ROUNDS( 15, m3, m0, m2 );
+        state0 = _mm_add_epi32( state0, abef );
+        state1 = _mm_add_epi32( state1, cdgh );
+        message += SHA224_256_BLOCK_SIZE;
+    }
+    tmp = _mm_shuffle_epi32( state0, 0x1B );
+    state1 = _mm_shuffle_epi32( state1, 0xB1 );
+    state0 = _mm_blend_epi16( tmp, state1, 0xF0 );
+    state1 = _mm_alignr_epi8( state1, tmp, 8 );
+    _mm_storeu_si128( ( __m128i * ) &h[0], state0 );
+    _mm_storeu_si128( ( __m128i * ) &h[4], state1 );
+}
+
+/*
+ * AVX2 multi-buffer: 8 independent messages, one per 32-bit lane, every
+ * state word and message word is a vector. One block of every lane per
+ * call, 'h' is state in [word][lane] order.
+ */
+#define _SHA_X8_ROTR( x, n ) \
+    _mm256_or_si256( _mm256_srli_epi32( x, n ), _mm256_slli_epi32( x, 32 - ( n ) ) )
+
+__attribute__( ( target( "avx2" ) ) )
+static void _sha256_load_x8( __m256i *w, const unsigned char *const *blocks,
+                             unsigned int off ) {
+    const __m256i mask = _mm256_set_epi64x( 0x0c0d0e0f08090a0bULL,
+                                            0x0405060700010203ULL,
+                                            0x0c0d0e0f08090a0bULL,
+                                            0x0405060700010203ULL );
+    __m256i r[8], t[8], u[8];
+    unsigned int i;
+    for( i = 0; i < 8; i++ ) {
+        r[i] = _mm256_loadu_si256( ( const __m256i * )( blocks[i] + off ) );
+    }
+    /*
+     * 8x8 transpose, r[i] are words of lane 'i', w[j] are words 'j' of all
+     * lanes:
+     */
+    for( i = 0; i < 8; i += 4 ) {
+        t[i + 0] = _mm256_unpacklo_epi32( r[i + 0], r[i + 1] );
+        t[i + 1] = _mm256_unpackhi_epi32( r[i + 0], r[i + 1] );
+        t[i + 2] = _mm256_unpacklo_epi32( r[i + 2], r[i + 3] );
+        t[i + 3] = _mm256_unpackhi_epi32( r[i + 2], r[i + 3] );
+        u[i + 0] = _mm256_unpacklo_epi64( t[i + 0], t[i + 2] );
+        u[i + 1] = _mm256_unpackhi_epi64( t[i + 0], t[i + 2] );
+        u[i + 2] = _mm256_unpacklo_epi64( t[i + 1], t[i + 3] );
+        u[i + 3] = _mm256_unpackhi_epi64( t[i + 1], t[i + 3] );
+    }
+    for( i = 0; i < 4; i++ ) {
+        w[i] = _mm256_shuffle_epi8( _mm256_permute2x128_si256( u[i], u[i + 4],
+                                    0x20 ), mask );
+        w[i + 4] = _mm256_shuffle_epi8( _mm256_permute2x128_si256( u[i],
+                                        u[i + 4], 0x31 ), mask );
+    }
+}
+
+__attribute__( ( target( "avx2" ) ) )
+static void _sha256_blocks_x8( unsigned int h[8][8],
+                               const unsigned char *const *blocks ) {
+    __m256i w[16];
+    __m256i a, b, c, d, e, f, g, hh, t1, t2, wj;
+    unsigned int j;
+    _sha256_load_x8( w, blocks, 0 );
+    _sha256_load_x8( w + 8, blocks, 32 );
+    a = _mm256_loadu_si256( ( const __m256i * ) h[0] );
+    b = _mm256_loadu_si256( ( const __m256i * ) h[1] );
+    c = _mm256_loadu_si256( ( const __m256i * ) h[2] );
+    d = _mm256_loadu_si256( ( const __m256i * ) h[3] );
+    e = _mm256_loadu_si256( ( const __m256i * ) h[4] );
+    f = _mm256_loadu_si256( ( const __m256i * ) h[5] );
+    g = _mm256_loadu_si256( ( const __m256i * ) h[6] );
+    hh = _mm256_loadu_si256( ( const __m256i * ) h[7] );
+    for( j = 0; j < 64; j++ ) {
+        if( j < 16 ) {
+            wj = w[j];
+        }
+        else {
+            __m256i w15 = w[( j - 15 ) & 15], w2 = w[( j - 2 ) & 15];
+            __m256i s0 = _mm256_xor_si256( _mm256_xor_si256( _SHA_X8_ROTR( w15,
+                                           7 ), _SHA_X8_ROTR( w15, 18 ) ),
+                                           _mm256_srli_epi32( w15, 3 ) );
+            __m256i s1 = _mm256_xor_si256( _mm256_xor_si256( _SHA_X8_ROTR( w2,
+                                           17 ), _SHA_X8_ROTR( w2, 19 ) ),
+                                           _mm256_srli_epi32( w2, 10 ) );
+            wj = _mm256_add_epi32( _mm256_add_epi32( w[j & 15], s0 ),
+                                   _mm256_add_epi32( w[( j - 7 ) & 15], s1 ) );
+            w[j & 15] = wj;
+        }
+        t1 = _mm256_add_epi32( hh, _mm256_xor_si256( _mm256_xor_si256(
+                                   _SHA_X8_ROTR( e, 6 ), _SHA_X8_ROTR( e, 11 ) ),
+                               _SHA_X8_ROTR( e, 25 ) ) );
+        t1 = _mm256_add_epi32( t1, _mm256_xor_si256( _mm256_and_si256( e, f ),
+                               _mm256_andnot_si256( e, g ) ) );
+        t1 = _mm256_add_epi32( t1, _mm256_add_epi32( wj,
+                               _mm256_set1_epi32( sha256_k[j] ) ) );
+        t2 = _mm256_xor_si256( _mm256_xor_si256( _SHA_X8_ROTR( a, 2 ),
+                               _SHA_X8_ROTR( a, 13 ) ), _SHA_X8_ROTR( a, 22 ) );
+        t2 = _mm256_add_epi32( t2, _mm256_or_si256( _mm256_and_si256( a, b ),
+                               _mm256_and_si256( c, _mm256_or_si256( a, b ) ) ) );
+        hh = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32( d, t1 );
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32( t1, t2 );
+    }
+#define _SHA_X8_STORE( i, v ) \
+    _mm256_storeu_si256( ( __m256i * ) h[i], _mm256_add_epi32( v, \
+                         _mm256_loadu_si256( ( const __m256i * ) h[i] ) ) )
+    _SHA_X8_STORE( 0, a );
+    _SHA_X8_STORE( 1, b );
+    _SHA_X8_STORE( 2, c );
+    _SHA_X8_STORE( 3, d );
+    _SHA_X8_STORE( 4, e );
+    _SHA_X8_STORE( 5, f );
+    _SHA_X8_STORE( 6, g );
+    _SHA_X8_STORE( 7, hh );
+#undef _SHA_X8_STORE
+}
+
+#elif defined(SHA256_ARM)
+
+/*
+ * ARMv8 crypto extensions, 4 rounds per sha256h/sha256h2 pair:
+ */
+static void _sha256_blocks_arm( unsigned int *h, const unsigned char *message,
+                                size_t block_nb ) {
+    uint32x4_t state0 = vld1q_u32( &h[0] );
+    uint32x4_t state1 = vld1q_u32( &h[4] );
+    uint32x4_t abcd, efgh, m[4], tmp, save;
+    unsigned int g;
+    while( block_nb-- ) {
+        abcd = state0;
+        efgh = state1;
+        for( g = 0; g < 4; g++ ) {
+            m[g] = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( message +
+                                         g * 16 ) ) );
+        }
+        for( g = 0; g < 16; g++ ) {
+            tmp = vaddq_u32( m[g & 3], vld1q_u32( &sha256_k[g * 4] ) );
+            save = state0;
+            state0 = vsha256hq_u32( state0, state1, tmp );
+            state1 = vsha256h2q_u32( state1, save, tmp );
+            if( g < 12 ) {
+                m[g & 3] = vsha256su1q_u32( vsha256su0q_u32( m[g & 3],
+                                            m[( g + 1 ) & 3] ), m[( g + 2 ) & 3],
+                                            m[( g + 3 ) & 3] );
+            }
+        }
+        state0 = vaddq_u32( state0, abcd );
+        state1 = vaddq_u32( state1, efgh );
+        message += SHA224_256_BLOCK_SIZE;
+    }
+    vst1q_u32( &h[0], state0 );
+    vst1q_u32( &h[4], state1 );
+}
+
+#endif
+
+/*
+ * Block function is selected at first call:
+ */
+static void _sha256_blocks_select( unsigned int *h,
+                                   const unsigned char *message,
+                                   size_t block_nb );
+static _sha256_blocks_f _sha256_blocks = _sha256_blocks_select;
+#if defined(SHA256_X86)
+static int _sha256_x8;
+#endif
+
+static _sha256_blocks_f _sha256_resolve( void ) {
+    _sha256_blocks_f blocks = _sha256_blocks_c;
+#if defined(SHA256_X86)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "sha" ) &&
+            __builtin_cpu_supports( "sse4.1" ) ) {
+        blocks = _sha256_blocks_shani;
+    }
+    /*
+     * SHA-NI single stream is faster than 8 AVX2 lanes, multi-buffer mode
+     * is used only without it:
+     */
+    else if( __builtin_cpu_supports( "avx2" ) ) {
+        _sha256_x8 = 1;
+    }
+#elif defined(SHA256_ARM)
+    blocks = _sha256_blocks_arm;
+#endif
+    __atomic_store_n( &_sha256_blocks, blocks, __ATOMIC_RELEASE );
+    return blocks;
+}
+
+static void _sha256_blocks_select( unsigned int *h,
+                                   const unsigned char *message,
+                                   size_t block_nb ) {
+    _sha256_resolve()( h, message, block_nb );
+}
+
+static void _transform( SHA256 *sha256, const unsigned char *message,
+                        unsigned int block_nb ) {
+    _sha256_blocks_f blocks;
+    if( !block_nb ) {
+        return;
+    }
+    blocks = __atomic_load_n( &_sha256_blocks, __ATOMIC_ACQUIRE );
+    blocks( sha256->m_h, message, block_nb );
+}
+
 SHA256 *sha256_init( SHA256 *sha256 ) {
     if( !sha256 ) {
         sha256 = Malloc( sizeof( SHA256 ) );
@@ -131,3 +418,118 @@ unsigned char *sha256_finalize( SHA256 *sha256, unsigned char *digest ) {
     return digest;
 }
 
+static const unsigned int sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/*
+ * Internal, build last 1 or 2 blocks of message: tail bytes, 0x80, zeroes
+ * and 64-bit length in bits. Return number of blocks.
+ */
+static unsigned int _sha256_pad( unsigned char *pad, const unsigned char *message,
+                                 size_t len ) {
+    size_t rem = len % SHA224_256_BLOCK_SIZE;
+    unsigned int block_nb = rem < SHA224_256_BLOCK_SIZE - 8 ? 1 : 2;
+    unsigned long long len_b = ( unsigned long long ) len << 3;
+    unsigned int pm_len = block_nb << 6;
+    memset( pad, 0, pm_len );
+    memcpy( pad, message + len - rem, rem );
+    pad[rem] = 0x80;
+    SHA2_UNPACK32( ( unsigned int )( len_b >> 32 ), pad + pm_len - 8 );
+    SHA2_UNPACK32( ( unsigned int ) len_b, pad + pm_len - 4 );
+    return block_nb;
+}
+
+static void _sha256_digest( const unsigned int *h, unsigned char *digest ) {
+    int i;
+    for( i = 0; i < 8; i++ ) {
+        SHA2_UNPACK32( h[i], &digest[i << 2] );
+    }
+}
+
+#if defined(SHA256_X86)
+
+/*
+ * Internal, hash up to 8 messages in AVX2 lanes. Lanes may have different
+ * lengths: lane which is done gets its own padding block again and its
+ * result is taken after its last block.
+ */
+static void _sha256_batch_x8( const unsigned char *const *messages,
+                              const size_t *lens, size_t n,
+                              unsigned char *digests ) {
+    unsigned int h[8][8];
+    unsigned char pad[8][2 * SHA224_256_BLOCK_SIZE];
+    const unsigned char *blocks[8];
+    size_t full[8], total[8], max = 0, b;
+    unsigned int i, j;
+    for( i = 0; i < 8; i++ ) {
+        size_t len = i < n ? lens[i] : 0;
+        const unsigned char *message = i < n ? messages[i] : pad[i];
+        full[i] = len / SHA224_256_BLOCK_SIZE;
+        total[i] = full[i] + _sha256_pad( pad[i], message, len );
+        if( total[i] > max ) {
+            max = total[i];
+        }
+        for( j = 0; j < 8; j++ ) {
+            h[j][i] = sha256_h0[j];
+        }
+    }
+    for( b = 0; b < max; b++ ) {
+        for( i = 0; i < 8; i++ ) {
+            if( b < full[i] ) {
+                blocks[i] = messages[i] + ( b << 6 );
+            }
+            else if( b < total[i] ) {
+                blocks[i] = pad[i] + ( ( b - full[i] ) << 6 );
+            }
+            else {
+                blocks[i] = pad[i];
+            }
+        }
+        _sha256_blocks_x8( h, blocks );
+        for( i = 0; i < n && i < 8; i++ ) {
+            if( b + 1 == total[i] ) {
+                unsigned int hi[8];
+                for( j = 0; j < 8; j++ ) {
+                    hi[j] = h[j][i];
+                }
+                _sha256_digest( hi, digests + i * SHA256_DIGEST_SIZE );
+            }
+        }
+    }
+}
+
+#endif
+
+/*
+ * Hash 'n' independent messages, digests are stored one after another to
+ * 'digests' (n * SHA256_DIGEST_SIZE bytes).
+ */
+void sha256_batch( const unsigned char *const *messages, const size_t *lens,
+                   size_t n, unsigned char *digests ) {
+    unsigned char pad[2 * SHA224_256_BLOCK_SIZE];
+    unsigned int h[8];
+    unsigned int block_nb;
+    _sha256_blocks_f blocks = __atomic_load_n( &_sha256_blocks,
+                              __ATOMIC_ACQUIRE );
+    size_t i = 0;
+    if( blocks == _sha256_blocks_select ) {
+        blocks = _sha256_resolve();
+    }
+#if defined(SHA256_X86)
+    if( _sha256_x8 ) {
+        for( ; i + 4 < n; i += 8 ) {
+            _sha256_batch_x8( messages + i, lens + i, n - i,
+                              digests + i * SHA256_DIGEST_SIZE );
+        }
+    }
+#endif
+    for( ; i < n; i++ ) {
+        memcpy( h, sha256_h0, sizeof( h ) );
+        blocks( h, messages[i], lens[i] / SHA224_256_BLOCK_SIZE );
+        block_nb = _sha256_pad( pad, messages[i], lens[i] );
+        blocks( h, pad, block_nb );
+        _sha256_digest( h, digests + i * SHA256_DIGEST_SIZE );
+    }
+}
@@ -31,6 +31,15 @@ SHA256 *sha256_init( SHA256 *sha256 );
 void sha256_update( SHA256 *sha256, const unsigned char *message,
                     unsigned int len );
 unsigned char *sha256_finalize( SHA256 *sha256, unsigned char *digest );
+/*
+ * Hash 'n' independent messages at once, digests are stored one after
+ * another to 'digests' (n * SHA256_DIGEST_SIZE bytes). Block function is
+ * selected at runtime (all API): SHA extensions on x86, crypto extensions
+ * on ARMv8; on x86 CPU without SHA extensions but with AVX2 batch hashes 8
+ * messages in parallel vector lanes.
+ */
+void sha256_batch( const unsigned char *const *messages, const size_t *lens,
+                   size_t n, unsigned char *digests );
 
 #define SHA2_SHFR(x, n)    (x >> n)
 #define SHA2_ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -0,0 +1,286 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "sha256tree.h"
+
+#if defined(USE_LOCKING) && !defined(__WINDOWS__)
+# define SHT_THREADS
+# include <pthread.h>
+#endif
+
+#define SHT_LEAF_PREFIX     0x00
+#define SHT_NODE_PREFIX     0x01
+
+SHTree SHT_create( size_t leaf_size, unsigned int nthreads )
+{
+    SHTree sht;
+
+    if( leaf_size > SHT_MAX_LEAF_SIZE ) {
+        return NULL;
+    }
+
+    sht = Calloc( sizeof( struct _SHTree ), 1 );
+
+    if( !sht ) {
+        return NULL;
+    }
+
+    sht->leaf_size = leaf_size ? leaf_size : SHT_LEAF_SIZE;
+#if defined(SHT_THREADS)
+
+    if( !nthreads ) {
+        long ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+        nthreads = ncpu > 0 ? ( unsigned int ) ncpu : 1;
+    }
+
+    sht->nthreads = nthreads < SHT_MAX_THREADS ? nthreads : SHT_MAX_THREADS;
+#else
+    unused( nthreads );
+    sht->nthreads = 1;
+#endif
+    return sht;
+}
+
+void SHT_destroy( SHTree sht )
+{
+    Free( sht->nodes );
+    Free( sht );
+}
+
+const unsigned char *SHT_root( const SHTree sht )
+{
+    return sht->nodes ? sht->nodes[sht->level_off[sht->nlevels - 1]] : NULL;
+}
+
+/*
+ * Internal, set levels for 'size' bytes of data. Leaves (level 0) are at
+ * the beginning of nodes array and stay there when array is reallocated.
+ * Return 0 or ENOMEM.
+ */
+static int _SHT_Layout( SHTree sht, size_t size )
+{
+    size_t off[SHT_MAX_LEVELS], num[SHT_MAX_LEVELS];
+    size_t n = size ? ( size - 1 ) / sht->leaf_size + 1 : 1;
+    size_t nnodes = 0;
+    unsigned int l = 0;
+
+    for( ;; ) {
+        off[l] = nnodes;
+        num[l] = n;
+        nnodes += n;
+        l++;
+
+        if( n == 1 ) {
+            break;
+        }
+
+        n = ( n + 1 ) / 2;
+    }
+
+    if( nnodes != sht->nnodes || !sht->nodes ) {
+        SHT_Hash *nodes = Realloc( sht->nodes, nnodes * sizeof( SHT_Hash ) );
+
+        if( !nodes ) {
+            return ENOMEM;
+        }
+
+        sht->nodes = nodes;
+        sht->nnodes = nnodes;
+    }
+
+    memcpy( sht->level_off, off, l * sizeof( size_t ) );
+    memcpy( sht->level_n, num, l * sizeof( size_t ) );
+    sht->nlevels = l;
+    sht->nleaves = num[0];
+    sht->size = size;
+    return 0;
+}
+
+/*
+ * Internal, leaves hashing job. Threads take next leaf index from shared
+ * counter until it passes 'last'.
+ */
+typedef struct _SHT_Job {
+    SHTree sht;
+    const unsigned char *data;
+    size_t next;
+    size_t last;
+} SHT_Job;
+
+static void *_SHT_Leaves( void *arg )
+{
+    SHT_Job *job = arg;
+    const SHTree sht = job->sht;
+    unsigned char prefix = SHT_LEAF_PREFIX;
+    SHA256 sha;
+    size_t i;
+
+    for( ;; ) {
+#if defined(SHT_THREADS)
+        i = __atomic_fetch_add( &job->next, 1, __ATOMIC_RELAXED );
+#else
+        i = job->next++;
+#endif
+
+        if( i > job->last ) {
+            break;
+        }
+
+        {
+            size_t off = i * sht->leaf_size;
+            size_t len = sht->size - off < sht->leaf_size ? sht->size - off :
+                         sht->leaf_size;
+            sha256_init( &sha );
+            sha256_update( &sha, &prefix, 1 );
+            sha256_update( &sha, job->data + off, ( unsigned int ) len );
+            sha256_finalize( &sha, sht->nodes[i] );
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Internal, hash leaves from 'first' to 'last' in up to sht->nthreads
+ * threads (current one included).
+ */
+static void _SHT_Hash_Leaves( SHTree sht, const void *data, size_t first,
+                              size_t last )
+{
+    SHT_Job job;
+#if defined(SHT_THREADS)
+    pthread_t threads[SHT_MAX_THREADS];
+    unsigned int i, n = sht->nthreads;
+
+    if( n > last - first + 1 ) {
+        n = ( unsigned int )( last - first + 1 );
+    }
+
+#endif
+    job.sht = sht;
+    job.data = data;
+    job.next = first;
+    job.last = last;
+#if defined(SHT_THREADS)
+
+    for( i = 1; i < n; i++ ) {
+        if( pthread_create( &threads[i], NULL, _SHT_Leaves, &job ) ) {
+            break;
+        }
+    }
+
+    n = i;
+    _SHT_Leaves( &job );
+
+    for( i = 1; i < n; i++ ) {
+        pthread_join( threads[i], NULL );
+    }
+
+#else
+    _SHT_Leaves( &job );
+#endif
+}
+
+/*
+ * Internal, hash nodes above leaves from 'first' to 'last', level by level
+ * up to the root.
+ */
+static void _SHT_Hash_Nodes( SHTree sht, size_t first, size_t last )
+{
+    unsigned char prefix = SHT_NODE_PREFIX;
+    unsigned int l;
+    SHA256 sha;
+    size_t i;
+
+    for( l = 1; l < sht->nlevels; l++ ) {
+        SHT_Hash *down = sht->nodes + sht->level_off[l - 1];
+        SHT_Hash *up = sht->nodes + sht->level_off[l];
+        first /= 2;
+        last /= 2;
+
+        for( i = first; i <= last; i++ ) {
+            if( 2 * i + 1 < sht->level_n[l - 1] ) {
+                sha256_init( &sha );
+                sha256_update( &sha, &prefix, 1 );
+                sha256_update( &sha, down[2 * i], 2 * SHA256_DIGEST_SIZE );
+                sha256_finalize( &sha, up[i] );
+            }
+            else {
+                memcpy( up[i], down[2 * i], SHA256_DIGEST_SIZE );
+            }
+        }
+    }
+}
+
+int SHT_hash( SHTree sht, const void *data, size_t size, SHT_Hash root )
+{
+    if( _SHT_Layout( sht, size ) ) {
+        return ENOMEM;
+    }
+
+    _SHT_Hash_Leaves( sht, data, 0, sht->nleaves - 1 );
+    _SHT_Hash_Nodes( sht, 0, sht->nleaves - 1 );
+
+    if( root ) {
+        memcpy( root, SHT_root( sht ), SHA256_DIGEST_SIZE );
+    }
+
+    return 0;
+}
+
+int SHT_update( SHTree sht, const void *data, size_t size, size_t offset,
+                size_t len, SHT_Hash root )
+{
+    size_t first = ( size_t ) - 1, last = 0;
+
+    if( offset > size || len > size - offset ) {
+        return EINVAL;
+    }
+
+    if( !sht->nodes ) {
+        return SHT_hash( sht, data, size, root );
+    }
+
+    if( len ) {
+        first = offset / sht->leaf_size;
+        last = ( offset + len - 1 ) / sht->leaf_size;
+    }
+
+    if( size != sht->size ) {
+        /*
+         * Leaves count and upper levels layout can be changed, leaves from
+         * the old (or new) end and all the nodes are hashed again:
+         */
+        size_t end = size < sht->size ? size : sht->size;
+
+        if( _SHT_Layout( sht, size ) ) {
+            return ENOMEM;
+        }
+
+        end = end ? ( end - 1 ) / sht->leaf_size : 0;
+
+        if( first > end ) {
+            first = end;
+        }
+
+        last = sht->nleaves - 1;
+        _SHT_Hash_Leaves( sht, data, first, last );
+        _SHT_Hash_Nodes( sht, 0, last );
+    }
+    else if( len ) {
+        _SHT_Hash_Leaves( sht, data, first, last );
+        _SHT_Hash_Nodes( sht, first, last );
+    }
+
+    if( root ) {
+        memcpy( root, SHT_root( sht ), SHA256_DIGEST_SIZE );
+    }
+
+    return 0;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,85 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef SHA256TREE_H_
+#define SHA256TREE_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "sha256.h"
+#include <errno.h>
+
+/*
+ * SHA-256 tree hash. Data is split into leaves of 'leaf_size' bytes (the
+ * last one can be shorter; empty data is one empty leaf), root is Merkle
+ * Tree Hash of RFC 6962 (section 2.1) over this leaves:
+ *
+ *   leaf hash = SHA-256( 0x00 || leaf bytes )
+ *   node hash = SHA-256( 0x01 || left hash || right hash )
+ *   MTH( n leaves ) = node( MTH( first k ), MTH( other n - k ) ), where k is
+ *   the largest power of 2 less than n; MTH( one leaf ) = leaf hash.
+ *
+ * The same is built level by level: adjacent nodes are paired, odd last
+ * node goes up unchanged. Root depends on 'leaf_size', so it should be
+ * stored together with the root. Leaves are hashed in parallel threads
+ * (USE_LOCKING only), all tree nodes are kept, so after changes of some data
+ * bytes only their leaves and paths to the root are hashed again.
+ */
+#define SHT_LEAF_SIZE       (1024*1024)
+#define SHT_MAX_LEAF_SIZE   (1024*1024*256)
+#define SHT_MAX_THREADS     64
+#define SHT_MAX_LEVELS      65
+
+typedef unsigned char SHT_Hash[SHA256_DIGEST_SIZE];
+
+typedef struct _SHTree {
+    size_t leaf_size;
+    unsigned int nthreads;
+    size_t size;                    /* data size */
+    size_t nleaves;
+    unsigned int nlevels;
+    size_t level_off[SHT_MAX_LEVELS];   /* level 0 is leaves, last is root */
+    size_t level_n[SHT_MAX_LEVELS];
+    SHT_Hash *nodes;
+    size_t nnodes;
+} *SHTree;
+
+/*
+ * 'leaf_size' can be 0 (SHT_LEAF_SIZE will be used), up to
+ * SHT_MAX_LEAF_SIZE. 'nthreads' is leaves hashing threads count, 0 means
+ * number of CPUs. Return created tree or NULL.
+ */
+SHTree SHT_create( size_t leaf_size, unsigned int nthreads );
+void SHT_destroy( SHTree sht );
+
+/*
+ * Hash whole data, root is copied to 'root' (can be NULL). Return 0
+ * (success) or ENOMEM.
+ */
+int SHT_hash( SHTree sht, const void *data, size_t size, SHT_Hash root );
+/*
+ * Re-hash after bytes [offset, offset + len) of data hashed before were
+ * changed. 'data' and 'size' are new data; if size was changed all leaves
+ * after the old or new end (whichever is smaller) are hashed too. Return 0
+ * (success), EINVAL (changed range is out of data) or ENOMEM.
+ */
+int SHT_update( SHTree sht, const void *data, size_t size, size_t offset,
+                size_t len, SHT_Hash root );
+/*
+ * Last computed root, NULL if there was no SHT_hash() call:
+ */
+const unsigned char *SHT_root( const SHTree sht );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* SHA256TREE_H_ */
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,113 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#include "slab.h"
+
+Slab slab_create( size_t obj_size, size_t align )
+{
+    Slab slab;
+
+    if( !align ) {
+        align = sizeof( void * );
+    }
+
+    if( align & ( align - 1 ) ) {
+        return NULL;
+    }
+
+    if( obj_size < sizeof( void * ) ) {
+        obj_size = sizeof( void * );
+    }
+
+    obj_size = ( obj_size + align - 1 ) & ~( align - 1 );
+    slab = Calloc( sizeof( struct _Slab ), 1 );
+
+    if( !slab ) {
+        return NULL;
+    }
+
+    slab->obj_size = obj_size;
+    slab->align = align;
+    /*
+     * Chunk link and alignment gap are at the beginning:
+     */
+    slab->chunk_size = sizeof( void * ) + align - 1 +
+                       ( obj_size * SLAB_CHUNK_MIN > SLAB_CHUNK_SIZE ?
+                         obj_size * SLAB_CHUNK_MIN : SLAB_CHUNK_SIZE );
+    __initlock( slab->lock );
+    return slab;
+}
+
+void slab_destroy( Slab slab )
+{
+    void *chunk = slab->chunks;
+
+    while( chunk ) {
+        void *next = *( void ** ) chunk;
+        Free( chunk );
+        chunk = next;
+    }
+
+    Free( slab );
+}
+
+/*
+ * Internal, add new chunk. Call with lock held.
+ */
+static int _slab_chunk( Slab slab )
+{
+    void **chunk = Malloc( slab->chunk_size );
+    size_t first;
+
+    if( !chunk ) {
+        return 0;
+    }
+
+    *chunk = slab->chunks;
+    slab->chunks = chunk;
+    slab->nchunks++;
+    first = ( ( size_t )( chunk + 1 ) + slab->align - 1 ) & ~( slab->align - 1 );
+    slab->next = ( char * ) first;
+    slab->end = ( char * ) chunk + slab->chunk_size;
+    return 1;
+}
+
+void *slab_alloc( Slab slab )
+{
+    void *ptr = NULL;
+    __lock( slab->lock );
+
+    if( slab->free ) {
+        ptr = slab->free;
+        slab->free = *( void ** ) ptr;
+    }
+    else if( ( size_t )( slab->end - slab->next ) >= slab->obj_size ||
+             _slab_chunk( slab ) ) {
+        ptr = slab->next;
+        slab->next += slab->obj_size;
+    }
+
+    if( ptr ) {
+        slab->nobjects++;
+    }
+
+    __unlock( slab->lock );
+    return ptr;
+}
+
+void slab_free( Slab slab, void *ptr )
+{
+    if( ptr ) {
+        __lock( slab->lock );
+        *( void ** ) ptr = slab->free;
+        slab->free = ptr;
+        slab->nobjects--;
+        __unlock( slab->lock );
+    }
+}
+
+/*
+ *  That's All, Folks!
+ */
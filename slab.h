@@ -0,0 +1,65 @@
+/*
+ *  Created on: 17 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef SLAB_H_
+#define SLAB_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "config.h"
+#include "_lock.h"
+
+/*
+ * Fixed-size objects allocator. Objects are cut from chunks of
+ * SLAB_CHUNK_SIZE bytes (or SLAB_CHUNK_MIN objects, if they are larger)
+ * without any per-object header, freed objects are kept in intrusive free
+ * list and reused first. Chunks are allocated with Malloc() (from mpool with
+ * USE_MPOOL) and are not returned until slab_destroy().
+ */
+#define SLAB_CHUNK_SIZE     (1024*64)
+#define SLAB_CHUNK_MIN      16
+
+typedef struct _Slab {
+    size_t obj_size;            /* rounded up to 'align' */
+    size_t align;
+    size_t chunk_size;
+    size_t nobjects;            /* allocated objects */
+    size_t nchunks;
+    void *free;                 /* free objects list */
+    char *next;                 /* unused tail of the last chunk */
+    char *end;
+    void *chunks;               /* chunks list, link is at chunk start */
+    __lock_t( lock );
+} *Slab;
+
+/*
+ * 'align' is power of 2 or 0 (pointer size). Objects can not be smaller
+ * than a pointer. Return created slab or NULL.
+ */
+Slab slab_create( size_t obj_size, size_t align );
+/*
+ * Release all chunks, all objects become invalid:
+ */
+void slab_destroy( Slab slab );
+/*
+ * Return object (not initialized) or NULL:
+ */
+void *slab_alloc( Slab slab );
+/*
+ * 'ptr' must be allocated from this slab (NULL is ignored):
+ */
+void slab_free( Slab slab, void *ptr );
+
+#if defined(__cplusplus)
+}; /* extern "C" */
+#endif
+
+#endif /* SLAB_H_ */
+
+/*
+ *  That's All, Folks!
+ */
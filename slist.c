@@ -15,15 +15,25 @@ SList slcreate( void ) {
     return lcreate( _sl_destroy );
 }
 
+SList slcreate_arena( Arena arena ) {
+    return lcreate_arena( NULL, arena );
+}
+
+static char *_sl_dup( List list, const char *data ) {
+    return list->arena ? arena_strdup( list->arena, data ) : Strdup( data );
+}
+
 char *sladd( List list, const char *data ) {
     if( list && data ) {
-        char *dup = Strdup( data );
+        char *dup = _sl_dup( list, data );
         if( dup ) {
             char *rc = ladd( list, dup );
             if( rc ) {
                 return rc;
             }
-            Free( dup );
+            if( !list->arena ) {
+                Free( dup );
+            }
         }
     }
     return NULL;
@@ -31,13 +41,15 @@ char *sladd( List list, const char *data ) {
 
 char *slpoke( List list, const char *data ) {
     if( list && data ) {
-        char *dup = Strdup( data );
+        char *dup = _sl_dup( list, data );
         if( dup ) {
             char *rc = lpoke( list, dup );
             if( rc ) {
                 return rc;
             }
-            Free( dup );
+            if( !list->arena ) {
+                Free( dup );
+            }
         }
     }
     return NULL;
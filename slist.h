@@ -23,6 +23,10 @@ extern "C"
 typedef List    SList;
 
 SList slcreate( void );
+/*
+ * Strings are copied to 'arena' too, see lcreate_arena():
+ */
+SList slcreate_arena( Arena arena );
 char *sladd( List list, const char *data );
 char *slpoke( List list, const char *data );
 
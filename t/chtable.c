@@ -0,0 +1,73 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * CHTable from several threads: every thread inserts and deletes its own
+ * keys, stripes are shared. CHT_del() must return 0 for existing keys and
+ * ENOKEY for deleted ones (run with -fsanitize=thread to see races).
+ */
+
+#include "../chtable.h"
+#include "t.h"
+#include <pthread.h>
+
+#define NTHREADS    4
+#define NKEYS       2000
+#define NROUNDS     20
+
+static CHTable cht;
+static long nbad;
+
+static void *_worker( void *data )
+{
+    size_t base = ( size_t ) data * NKEYS;
+    size_t i, r;
+
+    for( r = 0; r < NROUNDS; r++ ) {
+        for( i = 0; i < NKEYS; i++ ) {
+            size_t key = base + i;
+            long bad = 0;
+
+            bad += CHT_set( cht, &key, sizeof( key ), ( void * ) 1 ) == NULL;
+            bad += CHT_val( cht, &key, sizeof( key ) ) != ( void * ) 1;
+            bad += CHT_del( cht, &key, sizeof( key ) ) != 0;
+            bad += CHT_del( cht, &key, sizeof( key ) ) != ENOKEY;
+
+            if( bad ) {
+                __atomic_add_fetch( &nbad, bad, __ATOMIC_RELAXED );
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int main( void )
+{
+    HT_Flags flags[] = { 0, HTF_FLAT, HTF_RCU };
+    pthread_t t[NTHREADS];
+    size_t i, j;
+
+    for( j = 0; j < sizeof( flags ) / sizeof( flags[0] ); j++ ) {
+        cht = CHT_create( 0, 4, 0, NULL, flags[j] );
+        T_CHECK( cht != NULL );
+
+        for( i = 0; i < NTHREADS; i++ ) {
+            pthread_create( &t[i], NULL, _worker, ( void * ) i );
+        }
+
+        for( i = 0; i < NTHREADS; i++ ) {
+            pthread_join( t[i], NULL );
+        }
+
+        T_CHECK( CHT_nitems( cht ) == 0 );
+        CHT_destroy( cht );
+    }
+
+    T_CHECK( nbad == 0 );
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,108 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * CHTable read/write throughput against thread count: 64 stripes (default)
+ * and 1 stripe (one lock for the whole table, as plain HTable). Keys are
+ * random integers from NKEYS range, half of them are in the table.
+ */
+
+#include "../chtable.h"
+#include "t.h"
+#include <pthread.h>
+
+#define NKEYS       (1024*1024)
+#define MAX_THREADS 16
+#define DURATION    0.5
+
+static CHTable cht;
+static unsigned int write_pct;
+static volatile int stop;
+
+static void *_worker( void *data )
+{
+    unsigned long long rnd = ( size_t ) data * 0x9E3779B97F4A7C15ull + 1;
+    size_t ops = 0;
+
+    while( !__atomic_load_n( &stop, __ATOMIC_RELAXED ) ) {
+        unsigned long long r = t_rand( &rnd );
+        size_t key = ( r >> 8 ) % NKEYS;
+
+        if( ( r & 0xff ) * 100 < write_pct * 256 ) {
+            if( r & 0x100 ) {
+                CHT_set( cht, &key, sizeof( key ), ( void * ) 1 );
+            }
+            else {
+                CHT_del( cht, &key, sizeof( key ) );
+            }
+        }
+        else {
+            CHT_val( cht, &key, sizeof( key ) );
+        }
+
+        ops++;
+    }
+
+    return ( void * ) ops;
+}
+
+static void _bench( size_t nshards, size_t nthreads )
+{
+    pthread_t t[MAX_THREADS];
+    size_t i, ops = 0;
+    double start;
+
+    cht = CHT_create( 0, nshards, NKEYS, NULL, 0 );
+
+    for( i = 0; i < NKEYS; i += 2 ) {
+        CHT_set( cht, &i, sizeof( i ), ( void * ) 1 );
+    }
+
+    stop = 0;
+    start = t_now();
+
+    for( i = 0; i < nthreads; i++ ) {
+        pthread_create( &t[i], NULL, _worker, ( void * ) i );
+    }
+
+    while( t_now() - start < DURATION ) {
+        usleep( 10000 );
+    }
+
+    __atomic_store_n( &stop, 1, __ATOMIC_RELAXED );
+
+    for( i = 0; i < nthreads; i++ ) {
+        void *n;
+        pthread_join( t[i], &n );
+        ops += ( size_t ) n;
+    }
+
+    printf( "writes %2u%%, stripes %2zu, threads %2zu: %7.2f Mops/s\n",
+            write_pct, nshards, nthreads, ops / ( t_now() - start ) / 1e6 );
+    CHT_destroy( cht );
+}
+
+int main( void )
+{
+    unsigned int writes[] = { 10, 50 };
+    size_t shards[] = { CHT_SHARDS, 1 };
+    size_t i, j, n;
+
+    printf( "%ld CPU(s) online\n", sysconf( _SC_NPROCESSORS_ONLN ) );
+
+    for( i = 0; i < sizeof( writes ) / sizeof( writes[0] ); i++ ) {
+        write_pct = writes[i];
+
+        for( j = 0; j < sizeof( shards ) / sizeof( shards[0] ); j++ ) {
+            for( n = 1; n <= MAX_THREADS; n *= 2 ) {
+                _bench( shards[j], n );
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  That's All, Folks!
+ */
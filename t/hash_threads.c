@@ -0,0 +1,115 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * Hash functions must be reentrant: threads hashing the same keys at once
+ * get the same values as one thread does. Chained _update calls must be
+ * equal to one call over the whole data (not for hash_jen: every call ends
+ * with final mixing).
+ */
+
+#include "../hash.h"
+#include "t.h"
+#include <pthread.h>
+
+#define NTHREADS    4
+#define NKEYS       4096
+#define NROUNDS     100
+#define NHASHES     4
+
+typedef unsigned( *hash_f )( const void *, size_t );
+typedef unsigned( *shash_f )( const char * );
+typedef unsigned( *hash_update_f )( unsigned, const void *, size_t );
+
+static hash_f hashes[NHASHES] = { hash_jen, hash_ly, hash_rot13, hash_rs };
+static shash_f shashes[NHASHES] = { shash_jen, shash_ly, shash_rot13,
+                                    shash_rs
+                                  };
+static hash_update_f updates[NHASHES] = { NULL, hash_ly_update,
+                                          hash_rot13_update, NULL
+                                        };
+
+static char keys[NKEYS][32];
+static unsigned ref[NHASHES][NKEYS];
+static unsigned long long ref_wy[NKEYS];
+
+/*
+ * Hash in two parts, split at 'half':
+ */
+static unsigned _hash_parts( int f, const char *key, size_t size,
+                             size_t half )
+{
+    unsigned a = 0;
+
+    if( hashes[f] == hash_jen ) {
+        return hash_jen( key, size );
+    }
+
+    if( updates[f] ) {
+        return updates[f]( updates[f]( 0, key, half ), key + half,
+                           size - half );
+    }
+
+    return hash_rs_update_r( hash_rs_update_r( 0, key, half, &a ),
+                             key + half, size - half, &a );
+}
+
+static void *_check( void *data )
+{
+    long bad = 0;
+    int r, f, i;
+    ( void ) data;
+
+    for( r = 0; r < NROUNDS; r++ ) {
+        for( i = 0; i < NKEYS; i++ ) {
+            size_t size = strlen( keys[i] );
+
+            for( f = 0; f < NHASHES; f++ ) {
+                bad += hashes[f]( keys[i], size ) != ref[f][i];
+                bad += shashes[f]( keys[i] ) != ref[f][i];
+                bad += _hash_parts( f, keys[i], size, ( r + i ) % size ) !=
+                       ref[f][i];
+            }
+
+            bad += hash_wy( keys[i], size ) != ref_wy[i];
+        }
+    }
+
+    return ( void * ) bad;
+}
+
+int main( void )
+{
+    pthread_t t[NTHREADS];
+    unsigned a = 0;
+    int f, i;
+
+    for( i = 0; i < NKEYS; i++ ) {
+        sprintf( keys[i], "key-%d-%d", i, i * i );
+
+        for( f = 0; f < NHASHES; f++ ) {
+            ref[f][i] = hashes[f]( keys[i], strlen( keys[i] ) );
+        }
+
+        ref_wy[i] = hash_wy( keys[i], strlen( keys[i] ) );
+    }
+
+    T_CHECK( shash_rs_update_r( shash_rs_update_r( 0, "ab", &a ), "c", &a ) ==
+             hash_rs( "abc", 3 ) );
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        pthread_create( &t[i], NULL, _check, NULL );
+    }
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        void *bad;
+        pthread_join( t[i], &bad );
+        T_CHECK( bad == NULL );
+    }
+
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,105 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * hash_wy() throughput and latency against other hash functions, keys from
+ * 4 bytes to 4 KiB.
+ */
+
+#include "../hash.h"
+#include "../crc.h"
+#include "t.h"
+
+#define BUF_SIZE    4096
+#define TOTAL_BYTES (256*1024*1024)
+
+typedef unsigned long long( *hash_f )( const void *, size_t );
+
+static unsigned long long _wy( const void *buf, size_t size )
+{
+    return hash_wy( buf, size );
+}
+
+static unsigned long long _jen( const void *buf, size_t size )
+{
+    return hash_jen( buf, size );
+}
+
+static unsigned long long _ly( const void *buf, size_t size )
+{
+    return hash_ly( buf, size );
+}
+
+static unsigned long long _rot13( const void *buf, size_t size )
+{
+    return hash_rot13( buf, size );
+}
+
+static unsigned long long _rs( const void *buf, size_t size )
+{
+    return hash_rs( buf, size );
+}
+
+static unsigned long long _crc32( const void *buf, size_t size )
+{
+    return crc32( buf, size );
+}
+
+static struct {
+    const char *name;
+    hash_f hash;
+} hashes[] = {
+    { "wy", _wy }, { "jen", _jen }, { "ly", _ly }, { "rot13", _rot13 },
+    { "rs", _rs }, { "crc32", _crc32 }
+};
+
+int main( void )
+{
+    static unsigned char buf[BUF_SIZE];
+    size_t sizes[] = { 4, 8, 16, 32, 64, 256, 1024, 4096 };
+    unsigned long long sum = 0;
+    size_t i, j, k;
+
+    for( i = 0; i < BUF_SIZE; i++ ) {
+        buf[i] = ( unsigned char )( i * 7 + 3 );
+    }
+
+    printf( "%6s", "bytes" );
+
+    for( j = 0; j < sizeof( hashes ) / sizeof( hashes[0] ); j++ ) {
+        printf( " %17s", hashes[j].name );
+    }
+
+    printf( "\n" );
+
+    for( i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ ) {
+        /*
+         * Short keys: call overhead is a part of the result:
+         */
+        size_t n = TOTAL_BYTES / ( sizes[i] + 16 );
+        printf( "%6zu", sizes[i] );
+
+        for( j = 0; j < sizeof( hashes ) / sizeof( hashes[0] ); j++ ) {
+            double t = t_now();
+
+            for( k = 0; k < n; k++ ) {
+                buf[0] = ( unsigned char ) k;
+                sum += hashes[j].hash( buf, sizes[i] );
+            }
+
+            t = t_now() - t;
+            printf( " %6.0f MB/s %4.0f ns", sizes[i] * n / t / 1e6,
+                    t / n * 1e9 );
+            fflush( stdout );
+        }
+
+        printf( "\n" );
+    }
+
+    printf( "(%llx)\n", sum & 1 );
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,105 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * HTF_FLAT (open addressing) against chained buckets: insert, lookup of
+ * present and missing keys, delete; integer and string keys.
+ */
+
+#include "../htable.h"
+#include "t.h"
+
+#define NKEYS_MAX   (1024*1024)
+#define KEY_SIZE    32
+
+static char ( *skeys )[KEY_SIZE];
+
+static void _bench( const char *name, HT_Flags flags, size_t n, int strings )
+{
+    HTable ht = HT_create_ex( 0, 0, NULL, flags );
+    size_t i, r, rounds = NKEYS_MAX / n, hit = 0;
+    double t, t_set, t_hit, t_miss, t_del;
+
+    t = t_now();
+
+    for( i = 0; i < n; i++ ) {
+        if( strings ) {
+            HT_set_c( ht, skeys[i], ( void * ) 1 );
+        }
+        else {
+            HT_set_szt( ht, i * 2, ( void * ) 1 );
+        }
+    }
+
+    t_set = t_now() - t;
+    t = t_now();
+
+    for( r = 0; r < rounds; r++ ) {
+        for( i = 0; i < n; i++ ) {
+            size_t k = ( i * 7919 ) % n;
+            hit += ( strings ? HT_get_c( ht, skeys[k] ) :
+                     HT_get_szt( ht, k * 2 ) ) != NULL;
+        }
+    }
+
+    t_hit = t_now() - t;
+    t = t_now();
+
+    for( r = 0; r < rounds; r++ ) {
+        for( i = 0; i < n; i++ ) {
+            hit += ( strings ? HT_get_c( ht, skeys[n + i] ) :
+                     HT_get_szt( ht, i * 2 + 1 ) ) != NULL;
+        }
+    }
+
+    t_miss = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < n; i++ ) {
+        if( strings ) {
+            HT_del_c( ht, skeys[i] );
+        }
+        else {
+            HT_del_szt( ht, i * 2 );
+        }
+    }
+
+    t_del = t_now() - t;
+    printf( "%-8s %-7s %8zu: set %6.1f  hit %6.1f  miss %6.1f  del %6.1f ns/op"
+            "  (hits %zu)\n", strings ? "string" : "integer", name, n,
+            t_set / n * 1e9, t_hit / ( n * rounds ) * 1e9,
+            t_miss / ( n * rounds ) * 1e9, t_del / n * 1e9, hit );
+    HT_destroy( ht );
+}
+
+int main( void )
+{
+    size_t sizes[] = { 1000, 64 * 1024, NKEYS_MAX };
+    size_t i;
+    int strings;
+
+    skeys = malloc( 2 * NKEYS_MAX * KEY_SIZE );
+
+    if( !skeys ) {
+        return EXIT_FAILURE;
+    }
+
+    for( i = 0; i < 2 * NKEYS_MAX; i++ ) {
+        sprintf( skeys[i], "key:%zu:%08x", i,
+                 ( unsigned )( i * 2654435761u ) );
+    }
+
+    for( strings = 0; strings < 2; strings++ ) {
+        for( i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ ) {
+            _bench( "chained", 0, sizes[i], strings );
+            _bench( "flat", HTF_FLAT, sizes[i], strings );
+        }
+    }
+
+    free( skeys );
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,91 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * Resize policy under churn: the table is filled up to the point where it
+ * has just been expanded, then keys are deleted and inserted around this
+ * size. Without hysteresis (shrink load is half of grow load) every round
+ * can expand and reduce the table; HT_set_policy() hysteresis and shrink
+ * delay must keep its size. Reports resizes and per-call latency.
+ */
+
+#include "../htable.h"
+#include "t.h"
+
+#define NROUNDS     250
+#define NCHURN      16
+#define NOPS        (NROUNDS * NCHURN * 2)
+
+static double lat[NOPS];
+
+static int _cmp_double( const void *a, const void *b )
+{
+    double x = *( const double * ) a;
+    double y = *( const double * ) b;
+    return x < y ? -1 : x > y;
+}
+
+static void _bench( const char *name, HT_Flags flags, unsigned int shrink,
+                    size_t delay )
+{
+    HTable ht = HT_create_ex( 0, 0, NULL, flags );
+    size_t n = 0, expand, reduce, r, i, op = 0;
+    double sum = 0, t;
+
+    HT_set_policy( ht, 0, shrink, 0, delay );
+
+    /*
+     * Fill until the table is expanded to 128K, last key is above threshold:
+     */
+    while( ht->size < 128 * 1024 ) {
+        HT_set_szt( ht, n++, ( void * ) 1 );
+    }
+
+    expand = ht->nexpand;
+    reduce = ht->nreduce;
+
+    for( r = 0; r < NROUNDS; r++ ) {
+        for( i = 0; i < NCHURN; i++ ) {
+            t = t_now();
+            HT_del_szt( ht, n - 1 - i );
+            lat[op++] = t_now() - t;
+        }
+
+        for( i = NCHURN; i; i-- ) {
+            t = t_now();
+            HT_set_szt( ht, n - i, ( void * ) 1 );
+            lat[op++] = t_now() - t;
+        }
+    }
+
+    for( i = 0; i < op; i++ ) {
+        sum += lat[i];
+    }
+
+    qsort( lat, op, sizeof( double ), _cmp_double );
+    printf( "%-7s %-22s: expands %5zu reduces %5zu | mean %8.1f  p50 %6.1f  "
+            "p99 %9.1f  max %10.1f ns\n", flags & HTF_FLAT ? "flat" : "chained",
+            name, ht->nexpand - expand, ht->nreduce - reduce, sum / op * 1e9,
+            lat[op / 2] * 1e9, lat[op * 99 / 100] * 1e9, lat[op - 1] * 1e9 );
+    HT_destroy( ht );
+}
+
+int main( void )
+{
+    HT_Flags flags[] = { 0, HTF_FLAT };
+    size_t i;
+
+    for( i = 0; i < sizeof( flags ) / sizeof( flags[0] ); i++ ) {
+        unsigned int half = ( ( flags[i] & HTF_FLAT ? HT_FLAT_GROW_LOAD :
+                                HT_GROW_LOAD ) + 1 ) / 2;
+        _bench( "no hysteresis", flags[i], half, 0 );
+        _bench( "shrink load", flags[i], HT_SHRINK_LOAD, 0 );
+        _bench( "shrink load and delay", flags[i], HT_SHRINK_LOAD, 1024 );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,115 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * HT_save() / HT_load_mmap() round trip for chained and flat tables.
+ * Lookups in a snapshot with a
+ * cycle in bucket chain must stop.
+ */
+
+#include "../htsnap.h"
+#include "t.h"
+
+#define NKEYS       10000
+#define SNAP_PATH   "htsnap_test.snap"
+
+static void _corrupt( const char *path )
+{
+    HTSnapHeader hdr;
+    struct _HTSnapItem item;
+    FILE *f = fopen( path, "r+b" );
+
+    T_CHECK( f != NULL );
+
+    if( !f ) {
+        return;
+    }
+
+    /*
+     * First item links to itself:
+     */
+    T_CHECK( fread( &hdr, sizeof( hdr ), 1, f ) == 1 );
+    T_CHECK( !fseek( f, hdr.items, SEEK_SET ) );
+    T_CHECK( fread( &item, sizeof( item ), 1, f ) == 1 );
+    item.next = hdr.items;
+    T_CHECK( !fseek( f, hdr.items, SEEK_SET ) );
+    T_CHECK( fwrite( &item, sizeof( item ), 1, f ) == 1 );
+    fclose( f );
+}
+
+static void _key( char *key, size_t i )
+{
+    /*
+     * Every 7th key is long (not inlined):
+     */
+    if( i % 7 ) {
+        sprintf( key, "key%zu", i );
+    }
+    else {
+        sprintf( key, "long-key-%0100zu", i );
+    }
+}
+
+static void _round_trip( unsigned flags )
+{
+    HTable ht = HT_create_ex( 0, 0, NULL, flags );
+    char key[128];
+    HTSnap snap;
+    size_t i, size;
+    int found = 0;
+
+    for( i = 0; i < NKEYS; i++ ) {
+        _key( key, i );
+        HT_set_c( ht, key, i & 1 ? "odd" : "even" );
+    }
+
+    T_CHECK( HT_save( ht, SNAP_PATH, NULL ) == 0 );
+    snap = HT_load_mmap( SNAP_PATH );
+    T_CHECK( snap != NULL );
+
+    if( snap ) {
+        T_CHECK( snap->hdr->nitems == NKEYS );
+
+        for( i = 0; i < NKEYS; i++ ) {
+            const char *val;
+            _key( key, i );
+            val = HT_snap_val( snap, key, strlen( key ), &size );
+            T_CHECK( val && !strcmp( val, i & 1 ? "odd" : "even" ) &&
+                     size == strlen( val ) + 1 );
+        }
+
+        T_CHECK( HT_snap_get( snap, "nokey", 5 ) == NULL );
+        HT_snap_close( snap );
+    }
+
+    _corrupt( SNAP_PATH );
+    snap = HT_load_mmap( SNAP_PATH );
+    T_CHECK( snap != NULL );
+
+    if( snap ) {
+        /*
+         * Missing keys of the first item bucket reach the cycle:
+         */
+        for( i = 0; i < 20 * NKEYS; i++ ) {
+            sprintf( key, "nokey%zu", i );
+            found += HT_snap_get( snap, key, strlen( key ) ) != NULL;
+        }
+
+        T_CHECK( found == 0 );
+        HT_snap_close( snap );
+    }
+
+    remove( SNAP_PATH );
+    HT_destroy( ht );
+}
+
+int main( void )
+{
+    _round_trip( 0 );
+    _round_trip( HTF_FLAT );
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
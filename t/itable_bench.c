@@ -0,0 +1,150 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * ITable against HT_*_ullong() calls (chained and HTF_FLAT tables): insert,
+ * lookup of present and missing keys, delete. Keys are ids with a stride
+ * of 4096 (typical for pointers / offsets) and random 64-bit values.
+ */
+
+#include "../itable.h"
+#include "../htable.h"
+#include "t.h"
+
+#define NKEYS       (1024*1024)
+#define NLOOKUPS    (4*NKEYS)
+
+static unsigned long long *keys;
+static unsigned long long *misses;
+static size_t *order;
+
+static void _report( const char *name, double set, double hit, double miss,
+                     double del )
+{
+    printf( "  %-14s set %6.1f  hit %6.1f  miss %6.1f  del %6.1f ns/op\n",
+            name, set / NKEYS * 1e9, hit / NLOOKUPS * 1e9,
+            miss / NLOOKUPS * 1e9, del / NKEYS * 1e9 );
+}
+
+static void _bench_it( void )
+{
+    ITable it = IT_create( 0, NULL );
+    double t, set, hit, miss, del;
+    size_t i, n = 0;
+
+    t = t_now();
+
+    for( i = 0; i < NKEYS; i++ ) {
+        IT_set( it, keys[i], ( void * ) 1 );
+    }
+
+    set = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NLOOKUPS; i++ ) {
+        n += IT_val( it, keys[order[i]] ) != NULL;
+    }
+
+    hit = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NLOOKUPS; i++ ) {
+        n += IT_val( it, misses[order[i]] ) != NULL;
+    }
+
+    miss = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NKEYS; i++ ) {
+        IT_del( it, keys[i] );
+    }
+
+    del = t_now() - t;
+    T_CHECK( n == NLOOKUPS );
+    _report( "IT_*", set, hit, miss, del );
+    IT_destroy( it );
+}
+
+static void _bench_ht( const char *name, HT_Hash_Functions hf,
+                       HT_Flags flags )
+{
+    HTable ht = HT_create_ex( hf, 0, NULL, flags );
+    double t, set, hit, miss, del;
+    size_t i, n = 0;
+
+    t = t_now();
+
+    for( i = 0; i < NKEYS; i++ ) {
+        HT_set_ullong( ht, keys[i], ( void * ) 1 );
+    }
+
+    set = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NLOOKUPS; i++ ) {
+        n += HT_val_ullong( ht, keys[order[i]] ) != NULL;
+    }
+
+    hit = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NLOOKUPS; i++ ) {
+        n += HT_val_ullong( ht, misses[order[i]] ) != NULL;
+    }
+
+    miss = t_now() - t;
+    t = t_now();
+
+    for( i = 0; i < NKEYS; i++ ) {
+        HT_del_ullong( ht, keys[i] );
+    }
+
+    del = t_now() - t;
+    T_CHECK( n == NLOOKUPS );
+    _report( name, set, hit, miss, del );
+    HT_destroy( ht );
+}
+
+int main( void )
+{
+    unsigned long long rnd = 1;
+    size_t i;
+    int random;
+
+    keys = malloc( NKEYS * sizeof( *keys ) );
+    misses = malloc( NKEYS * sizeof( *misses ) );
+    order = malloc( NLOOKUPS * sizeof( *order ) );
+
+    if( !keys || !misses || !order ) {
+        return EXIT_FAILURE;
+    }
+
+    for( i = 0; i < NLOOKUPS; i++ ) {
+        order[i] = t_rand( &rnd ) % NKEYS;
+    }
+
+    for( random = 0; random < 2; random++ ) {
+        for( i = 0; i < NKEYS; i++ ) {
+            /*
+             * Even keys are in the table, odd ones are missing:
+             */
+            keys[i] = random ? t_rand( &rnd ) & ~1ull : i * 4096 + 4096;
+            misses[i] = random ? t_rand( &rnd ) | 1 : i * 4096 + 2048;
+        }
+
+        printf( "%s keys:\n", random ? "random" : "4096 stride" );
+        _bench_it();
+        _bench_ht( "HT chained", 0, 0 );
+        _bench_ht( "HT chained wy", HF_HASH_WY, 0 );
+        _bench_ht( "HT flat", 0, HTF_FLAT );
+    }
+
+    free( keys );
+    free( misses );
+    free( order );
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
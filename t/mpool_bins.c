@@ -0,0 +1,137 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * mpool stress test: random mp_alloc() / mp_realloc() / mp_free() with
+ * content checks for scanned pools and MPF_BINS ones, then for 4 threads
+ * with MPF_BINS and MPF_TCACHE. When all blocks are freed every pool of
+ * the chain must be one free block.
+ */
+
+#include "../mpool.h"
+#include "t.h"
+#include <pthread.h>
+#include <string.h>
+
+#define NSLOTS      3000
+#define NITERS      400000
+#define NTHREADS    4
+
+static void _walker( const mpool mp, const mblk mb, void *data )
+{
+    size_t *counts = data;
+    unused( mp );
+    counts[( mb->flags & MBF_BUSY ) ? 1 : 0]++;
+}
+
+static void _check_free( mpool mp )
+{
+    size_t counts[2] = { 0, 0 };
+    size_t npools = 0;
+    mpool p;
+
+    for( p = mp; p; p = p->next ) {
+        npools++;
+    }
+
+    mp_walk( mp, _walker, counts );
+    T_CHECK( counts[1] == 0 );
+    T_CHECK( counts[0] == npools );
+}
+
+static size_t _size( unsigned long long *rnd )
+{
+    unsigned long long r = t_rand( rnd );
+    return r % 10 ? r % 200 : r % 20000;
+}
+
+static void *_stress( void *data )
+{
+    mpool mp = data;
+    unsigned long long rnd = ( size_t ) pthread_self() | 1;
+    static __thread void *slots[NSLOTS];
+    static __thread size_t sizes[NSLOTS];
+    size_t i, k;
+
+    for( i = 0; i < NITERS; i++ ) {
+        size_t n = t_rand( &rnd ) % NSLOTS;
+        unsigned char *p = slots[n];
+
+        if( p ) {
+            for( k = 0; k < sizes[n]; k++ ) {
+                if( p[k] != ( unsigned char ) n ) {
+                    T_CHECK( p[k] == ( unsigned char ) n );
+                    break;
+                }
+            }
+
+            if( i & 1 ) {
+                T_CHECK( mp_free( mp, p ) == 1 );
+                slots[n] = NULL;
+                continue;
+            }
+
+            sizes[n] = _size( &rnd );
+            p = mp_realloc( mp, p, sizes[n] );
+        }
+        else {
+            sizes[n] = _size( &rnd );
+            p = mp_alloc( mp, sizes[n] );
+        }
+
+        T_CHECK( p != NULL );
+
+        if( p ) {
+            memset( p, ( unsigned char ) n, sizes[n] );
+        }
+
+        slots[n] = p;
+    }
+
+    for( i = 0; i < NSLOTS; i++ ) {
+        if( slots[i] ) {
+            T_CHECK( mp_free( mp, slots[i] ) == 1 );
+            slots[i] = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+int main( void )
+{
+    mp_flags flags[] = { 0, MPF_FAST, MPF_BINS, MPF_BINS | MPF_FAST };
+    pthread_t t[NTHREADS];
+    mpool mp;
+    size_t i;
+
+    for( i = 0; i < sizeof( flags ) / sizeof( flags[0] ); i++ ) {
+        mp = mp_create( 1024 * 1024, flags[i] | MPF_EXPAND );
+        T_CHECK( mp != NULL );
+        _stress( mp );
+        _check_free( mp );
+        mp_destroy( mp );
+    }
+
+    /*
+     * Thread caches keep blocks busy until thread exit:
+     */
+    mp = mp_create( 1024 * 1024, MPF_BINS | MPF_TCACHE | MPF_EXPAND );
+    T_CHECK( mp != NULL );
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        pthread_create( &t[i], NULL, _stress, mp );
+    }
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        pthread_join( t[i], NULL );
+    }
+
+    _check_free( mp );
+    mp_destroy( mp );
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
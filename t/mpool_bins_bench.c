@@ -0,0 +1,79 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * mp_free() + mp_alloc() pair cost against live blocks count: MPF_BINS
+ * segregated free lists against the free block scan (best fit, and first
+ * fit with MPF_FAST). Pool is fragmented first: every second block is
+ * freed and allocated again with another size. Scanned pools take about a
+ * minute to fill with 100000 blocks.
+ */
+
+#include "../mpool.h"
+#include "t.h"
+
+#define POOL_SIZE   (64*1024*1024)
+#define MIN_SIZE    16
+#define MAX_SIZE    216
+
+static size_t _size( unsigned long long *rnd )
+{
+    return MIN_SIZE + t_rand( rnd ) % ( MAX_SIZE - MIN_SIZE );
+}
+
+static void _bench( const char *name, mp_flags flags, size_t nlive )
+{
+    mpool mp = mp_create( POOL_SIZE, flags );
+    void **live = malloc( nlive * sizeof( void * ) );
+    unsigned long long rnd = 1;
+    /*
+     * Scan cost grows with live blocks, keep run time reasonable:
+     */
+    size_t i, n = ( flags & MPF_BINS ) ? 2000000 : 20000000 / nlive + 100;
+    double t;
+
+    if( !mp || !live ) {
+        printf( "no memory\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    for( i = 0; i < nlive; i++ ) {
+        live[i] = mp_alloc( mp, _size( &rnd ) );
+    }
+
+    for( i = 0; i < nlive; i += 2 ) {
+        mp_free( mp, live[i] );
+        live[i] = mp_alloc( mp, _size( &rnd ) );
+    }
+
+    t = t_now();
+
+    for( i = 0; i < n; i++ ) {
+        size_t k = t_rand( &rnd ) % nlive;
+        mp_free( mp, live[k] );
+        live[k] = mp_alloc( mp, _size( &rnd ) );
+    }
+
+    t = t_now() - t;
+    printf( "live %7zu %-5s: %10.1f ns/pair\n", nlive, name, t / n * 1e9 );
+    fflush( stdout );
+    free( live );
+    mp_destroy( mp );
+}
+
+int main( void )
+{
+    size_t nlive;
+
+    for( nlive = 100; nlive <= 100000; nlive *= 10 ) {
+        _bench( "scan", 0, nlive );
+        _bench( "fast", MPF_FAST, nlive );
+        _bench( "bins", MPF_BINS, nlive );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,106 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ *
+ * MPF_TCACHE: thread caches must never keep blocks of destroyed pools.
+ */
+
+#include "../mpool.h"
+#include "t.h"
+#include <pthread.h>
+#include <string.h>
+
+#define NTHREADS    4
+#define NBLOCKS     256
+#define NROUNDS     200
+
+static void *_churn( void *data )
+{
+    mpool mp = data;
+    void *p[NBLOCKS];
+    int i, j;
+
+    for( j = 0; j < NROUNDS; j++ ) {
+        for( i = 0; i < NBLOCKS; i++ ) {
+            p[i] = mp_alloc( mp, 1 + ( i * 7 ) % MP_TCACHE_MAX );
+            T_CHECK( p[i] != NULL );
+
+            if( p[i] ) {
+                memset( p[i], i, 1 + ( i * 7 ) % MP_TCACHE_MAX );
+            }
+        }
+
+        for( i = 0; i < NBLOCKS; i++ ) {
+            mp_free( mp, p[i] );
+        }
+    }
+
+    return NULL;
+}
+
+int main( void )
+{
+    mpool a, b;
+    void *p;
+    pthread_t t[NTHREADS];
+    int i, j;
+
+    /*
+     * Destroy pool with cached blocks, then create another one: new pool
+     * must not get a cache slot still filled with freed blocks.
+     */
+    a = mp_create( 4096, MPF_TCACHE );
+    mp_free( a, mp_alloc( a, 32 ) );
+    mp_destroy( a );
+    b = mp_create( 4096, MPF_TCACHE );
+    p = mp_alloc( b, 32 );
+    T_CHECK( p != NULL );
+    memset( p, 0, 32 );
+    T_CHECK( mp_free( b, p ) != 0 );
+    mp_destroy( b );
+
+    /*
+     * The same with more pools than cache slots, so slots are evicted too:
+     */
+    for( j = 0; j < 3 * MP_TCACHE_POOLS; j++ ) {
+        mpool pools[MP_TCACHE_POOLS + 1];
+
+        for( i = 0; i <= MP_TCACHE_POOLS; i++ ) {
+            pools[i] = mp_create( 1024 * 64, MPF_TCACHE | MPF_EXPAND );
+            T_CHECK( pools[i] != NULL );
+            _churn( pools[i] );
+        }
+
+        for( i = 0; i <= MP_TCACHE_POOLS; i += 2 ) {
+            mp_destroy( pools[i] );
+        }
+
+        for( i = 1; i <= MP_TCACHE_POOLS; i += 2 ) {
+            _churn( pools[i] );
+            mp_destroy( pools[i] );
+        }
+    }
+
+    /*
+     * Threads exit after their pool is destroyed:
+     */
+    a = mp_create( 1024 * 64, MPF_TCACHE | MPF_EXPAND );
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        pthread_create( &t[i], NULL, _churn, a );
+    }
+
+    for( i = 0; i < NTHREADS; i++ ) {
+        pthread_join( t[i], NULL );
+    }
+
+    mp_destroy( a );
+    b = mp_create( 1024 * 64, MPF_TCACHE | MPF_EXPAND );
+    _churn( b );
+    mp_destroy( b );
+    return T_DONE();
+}
+
+/*
+ *  That's All, Folks!
+ */
@@ -0,0 +1,62 @@
+/*
+ *  Created on: 18 окт. 2026 г.
+ *      Author: klopp
+ */
+
+#ifndef T_H_
+#define T_H_
+
+/*
+ * Common helpers for tests and benchmarks in t/ (see README.md for build
+ * lines). Test programs exit with non-zero code if any T_CHECK() failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int t_failed = 0;
+
+#define T_CHECK( expr ) \
+    do { \
+        if( !( expr ) ) { \
+            fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                     #expr ); \
+            t_failed++; \
+        } \
+    } while( 0 )
+
+/*
+ * Print result, return exit code for main():
+ */
+static inline int t_done( const char *file )
+{
+    printf( "%s: %s\n", file, t_failed ? "FAILED" : "ok" );
+    return t_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#define T_DONE() t_done( __FILE__ )
+
+static inline double t_now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * xorshift64, reproducible keys for benchmarks:
+ */
+static inline unsigned long long t_rand( unsigned long long *state )
+{
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+#endif /* T_H_ */
+
+/*
+ *  That's All, Folks!
+ */